@@ -0,0 +1,18 @@
+#ifndef ASSIGNMENT_H
+#define ASSIGNMENT_H
+
+/**
+ * @brief Risolve un problema di assegnamento a costo minimo (algoritmo ungherese).
+ *
+ * Assegna ognuna delle n righe a una colonna distinta tra le m disponibili (n <= m)
+ * minimizzando la somma dei costi. Complessità O(n^2 * m).
+ *
+ * @param n Numero di righe.
+ * @param m Numero di colonne (almeno n).
+ * @param cost Matrice dei costi n x m, per righe (cost[i * m + j]).
+ * @param row_to_col Array di n elementi in cui scrivere la colonna assegnata a ogni riga.
+ * @return 0 in caso di successo, -1 se n > m o se la memoria è insufficiente.
+ */
+int assignment_solve(int n, int m, const long long* cost, int* row_to_col);
+
+#endif // ASSIGNMENT_H
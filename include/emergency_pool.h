@@ -0,0 +1,37 @@
+#ifndef EMERGENCY_POOL_H
+#define EMERGENCY_POOL_H
+
+#include "types.h"
+
+/**
+ * @brief Prepara il pool delle emergenze.
+ *
+ * Le emergenze vengono allocate a blocchi (slab) e riciclate tramite una free list:
+ * a regime ricevere, gestire e concludere un'emergenza non richiede malloc né free.
+ * C'è una free list per tipo di emergenza, così l'elenco dei soccorritori assegnati in
+ * coda a ogni emergenza è dimensionato esattamente sul totale richiesto dal suo tipo.
+ *
+ * @param types Tipi di emergenza caricati da file.
+ * @param type_count Numero di tipi di emergenza.
+ */
+void emergency_pool_init(emergency_type_t* types, int type_count);
+
+/**
+ * @brief Preleva dal pool un'emergenza libera del tipo indicato.
+ *
+ * L'emergenza restituita punta al tipo, ne eredita la priorità, ha l'elenco dei soccorritori
+ * vuoto, stato WAITING e non è in coda; ID e coordinate vanno impostati dal chiamante.
+ *
+ * @param type Tipo dell'emergenza (deve appartenere alla tabella passata a emergency_pool_init).
+ * @return L'emergenza, NULL se non è possibile allocare un nuovo blocco.
+ */
+emergency_t* emergency_pool_get(const emergency_type_t* type);
+
+/**
+ * @brief Restituisce al pool un'emergenza conclusa (il suo lock deve essere già rilasciato).
+ *
+ * @param e Emergenza da riciclare.
+ */
+void emergency_pool_put(emergency_t* e);
+
+#endif // EMERGENCY_POOL_H
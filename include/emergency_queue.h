@@ -3,8 +3,14 @@
 
 #include "types.h"
 
-void emergency_queue_init();
-void emergency_queue_add(emergency_t* emergenza);
+void emergency_queue_init(int soft_limit, int hard_limit);
+int emergency_queue_add(emergency_t* emergenza);
+int emergency_queue_add_batch(emergency_t** emergenze, int n);
+int emergency_queue_requeue(emergency_t* emergenza);
+int emergency_queue_wait_space();
 emergency_t* emergency_queue_get();
+int emergency_queue_get_batch(emergency_t** emergenze, int max, int window_ms);
+int emergency_queue_remove(emergency_t* emergenza);
+int emergency_queue_update_priority(emergency_t* emergenza, short priority);
 
 #endif // EMERGENCY_QUEUE_H
\ No newline at end of file
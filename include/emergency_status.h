@@ -6,4 +6,22 @@
 
 void update_emergency_status(emergency_t* em, emergency_status_t new_status);
 
+/**
+ * @brief Segna il soccorritore in rientro e completa l'emergenza se era l'ultimo impegnato.
+ */
+void release_emergency_rescuer(emergency_t* em, rescuer_digital_twin_t* r);
+
+/**
+ * @brief Verifica, senza modificarla, che un'emergenza in corso sia sospendibile richiamando recalled soccorritori.
+ * @return 1 se è IN_PROGRESS e i soccorritori impegnati sono esattamente recalled, 0 altrimenti.
+ */
+int emergency_pausable(emergency_t* em, int recalled);
+
+/**
+ * @brief Sospende (PAUSED) un'emergenza in corso i cui soccorritori sono stati richiamati.
+ * L'intervento svolto da ogni soccorritore viene accreditato al suo posto nella squadra.
+ * @return 0 se l'emergenza è stata sospesa, -1 se nel frattempo è cambiata.
+ */
+int pause_emergency(emergency_t* em, int recalled, const int* slots, const int* work_done);
+
 #endif // EMERGENCYSTATUS_H
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef ETA_H
+#define ETA_H
+
+/**
+ * @brief Calcolo vettoriale dei tempi di arrivo (ETA) di un gruppo di soccorritori dello stesso tipo.
+ *
+ * L'ETA è quello dello scheduler: (|dx| + |dy|) / velocità, con divisione intera. Le posizioni
+ * dei candidati sono in due array paralleli (x e y). Il kernel viene scelto una sola volta
+ * all'avvio in base alla CPU: AVX2 (8 candidati per istruzione), SSE4.1 (4) o scalare.
+ * Tutti i kernel restituiscono esattamente gli stessi risultati (le coordinate della mappa
+ * stanno in 16 bit, quindi la divisione in virgola mobile troncata coincide con quella intera).
+ */
+
+/**
+ * @brief Calcola l'ETA di tutti i candidati verso un punto.
+ *
+ * @param xs Coordinate X dei candidati.
+ * @param ys Coordinate Y dei candidati.
+ * @param n Numero di candidati.
+ * @param x Coordinata X dell'emergenza.
+ * @param y Coordinata Y dell'emergenza.
+ * @param speed Velocità del tipo di soccorritore (> 0).
+ * @param out Array in cui scrivere gli n ETA in secondi.
+ */
+void eta_compute(const int* xs, const int* ys, int n, int x, int y, int speed, int* out);
+
+/**
+ * @brief Trova, in una sola passata, i k candidati con ETA minore verso un punto.
+ *
+ * @param xs Coordinate X dei candidati.
+ * @param ys Coordinate Y dei candidati.
+ * @param n Numero di candidati.
+ * @param x Coordinata X dell'emergenza.
+ * @param y Coordinata Y dell'emergenza.
+ * @param speed Velocità del tipo di soccorritore (> 0).
+ * @param k Numero di candidati richiesti.
+ * @param out_idx Array (almeno k elementi) in cui scrivere gli indici, per ETA crescente
+ *                (a parità di ETA, per indice crescente).
+ * @param out_eta Array (almeno k elementi) in cui scrivere gli ETA corrispondenti.
+ * @return Numero di candidati restituiti (il minimo tra k e n).
+ */
+int eta_top_k(const int* xs, const int* ys, int n, int x, int y, int speed, int k, int* out_idx, int* out_eta);
+
+/**
+ * @brief Nome del kernel in uso ("avx2", "sse4.1" o "scalar").
+ */
+const char* eta_kernel_name(void);
+
+/**
+ * @brief Forza un kernel (usato dal benchmark per confrontarli).
+ *
+ * @param name Nome del kernel ("avx2", "sse4.1" o "scalar").
+ * @return 0 se il kernel è stato selezionato, -1 se è sconosciuto o non supportato dalla CPU.
+ */
+int eta_use_kernel(const char* name);
+
+#endif // ETA_H
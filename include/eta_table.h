@@ -0,0 +1,44 @@
+#ifndef ETA_TABLE_H
+#define ETA_TABLE_H
+
+#include "types.h"
+
+/**
+ * @brief Tabelle precalcolate dei tempi di viaggio dalla base di ogni tipo di soccorritore.
+ *
+ * Per ogni tipo di soccorritore una tabella contiene, per ogni punto della mappa, il tempo di
+ * viaggio in secondi dalla base del tipo a quel punto: lookup O(1) invece del calcolo a ogni
+ * decisione. Le tabelle sono costruite all'avvio, un thread per tipo, e salvate in file di cache
+ * (nella directory eta_cache_dir di env.conf) mappati in memoria: agli avvii successivi, con stessa
+ * mappa, base e velocità, vengono solo mappate. I tempi sono memorizzati su 16 bit: un tipo che
+ * potrebbe superarli (mappa grande e velocità bassa) resta senza tabella. Oggi il costo è la distanza di Manhattan divisa per la velocità,
+ * come nel resto del sistema; l'intestazione del file registra il modello di costo, così una
+ * tabella con costi stradali diversi invaliderebbe da sola le cache precedenti.
+ */
+
+/**
+ * @brief Costruisce (o carica dalla cache) le tabelle di tutti i tipi di soccorritore, in parallelo.
+ *
+ * La directory della cache viene creata se manca. Se la cache non è utilizzabile la tabella resta
+ * solo in memoria; se anche la memoria manca, o i tempi del tipo non stanno in 16 bit, il tipo resta
+ * senza tabella e eta_table_lookup restituisce -1 (i chiamanti ricalcolano il tempo).
+ *
+ * @param types Array dei tipi di soccorritore caricati da file (types[i].rescuer_type.id == i).
+ * @param type_count Numero di tipi di soccorritore.
+ * @param width Larghezza della mappa.
+ * @param height Altezza della mappa.
+ * @param cache_dir Directory dei file di cache (una tabella per tipo di soccorritore).
+ */
+void eta_table_init(rescuer_type_info_t* types, int type_count, int width, int height, const char* cache_dir);
+
+/**
+ * @brief Tempo di viaggio dalla base di un tipo di soccorritore a un punto della mappa.
+ *
+ * @param type_id ID del tipo di soccorritore.
+ * @param x Coordinata X del punto.
+ * @param y Coordinata Y del punto.
+ * @return Tempo di viaggio in secondi, -1 se il punto è fuori mappa o il tipo non ha una tabella.
+ */
+int eta_table_lookup(int type_id, int x, int y);
+
+#endif // ETA_TABLE_H
@@ -0,0 +1,105 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "types.h"
+
+/**
+ * @brief Stato "caldo" della flotta in array paralleli e contigui (structure of arrays).
+ *
+ * Per ogni soccorritore, indicizzato per ID del gemello digitale, mantiene posizione, stato, tipo,
+ * emergenza assegnata (ID, priorità e posto nella squadra). Le scansioni dell'intera flotta diventano così passate
+ * sequenziali su pochi byte per soccorritore, senza seguire i puntatori rescuer_thread_t →
+ * gemello → tipo e senza toccare i mutex. I valori sono atomici: lo stato autorevole resta
+ * quello del gemello (protetto dal suo mutex), di cui questi array sono una copia pubblicata
+ * a ogni transizione. Chi deve agire su un soccorritore trovato con una scansione ne verifica
+ * lo stato sotto il suo mutex.
+ */
+
+/**
+ * @brief Alloca gli array della flotta (soccorritori fermi, IDLE, senza emergenza).
+ *
+ * @param unit_count Numero totale di soccorritori.
+ */
+void fleet_init(int unit_count);
+
+/**
+ * @brief Registra il tipo di un soccorritore.
+ *
+ * Il tipo non cambia: va registrato all'avvio, prima che la flotta sia condivisa tra i thread.
+ *
+ * @param id ID del gemello digitale.
+ * @param type_id ID del tipo di soccorritore.
+ */
+void fleet_set_type(int id, int type_id);
+
+/**
+ * @brief Tipo di un soccorritore. Non acquisisce lock.
+ *
+ * @param id ID del gemello digitale.
+ * @return ID del tipo di soccorritore (-1 se il soccorritore non esiste).
+ */
+int fleet_type(int id);
+
+/**
+ * @brief Pubblica stato ed emergenza assegnata di un soccorritore.
+ *
+ * @param id ID del gemello digitale.
+ * @param status Nuovo stato.
+ * @param em Emergenza assegnata (NULL se nessuna).
+ * @param slot Posto del soccorritore nella squadra di em (ignorato se em è NULL).
+ */
+void fleet_set_state(int id, rescuer_status_t status, const emergency_t* em, int slot);
+
+/**
+ * @brief Emergenza assegnata a un soccorritore e suo posto nella squadra. Non acquisisce lock.
+ *
+ * @param id ID del gemello digitale.
+ * @param em_id Restituisce l'ID dell'emergenza (-1 se nessuna).
+ * @param slot Restituisce il posto nella squadra (-1 se nessuno).
+ */
+void fleet_assignment(int id, int* em_id, int* slot);
+
+/**
+ * @brief Pubblica la posizione di un soccorritore.
+ *
+ * @param id ID del gemello digitale.
+ * @param x Coordinata X.
+ * @param y Coordinata Y.
+ */
+void fleet_set_position(int id, int x, int y);
+
+/**
+ * @brief Posizione attuale di un soccorritore. Non acquisisce lock.
+ *
+ * @param id ID del gemello digitale.
+ * @param x Restituisce la coordinata X.
+ * @param y Restituisce la coordinata Y.
+ */
+void fleet_position(int id, int* x, int* y);
+
+/**
+ * @brief Trova i soccorritori dei tipi indicati impegnati (in viaggio o sulla scena) su emergenze meno urgenti.
+ *
+ * Una sola passata sugli array di tipo, stato e priorità, senza lock: il risultato va verificato
+ * sotto il mutex di ciascun soccorritore.
+ *
+ * @param below_priority Priorità (esclusa) sotto cui l'emergenza assegnata deve stare.
+ * @param types ID dei tipi di soccorritore cercati.
+ * @param type_count Numero di tipi cercati.
+ * @param out Array in cui scrivere gli ID trovati (almeno unit_count elementi).
+ * @return Numero di soccorritori trovati.
+ */
+int fleet_scan_busy(int below_priority, const int* types, int type_count, int* out);
+
+/**
+ * @brief Trova i soccorritori impegnati (in viaggio o sulla scena) su un'emergenza, di qualunque tipo.
+ *
+ * Come fleet_scan_busy non acquisisce lock: il risultato va verificato sotto il mutex di ciascun soccorritore.
+ *
+ * @param em_id ID dell'emergenza.
+ * @param out Array in cui scrivere gli ID trovati (almeno unit_count elementi).
+ * @return Numero di soccorritori trovati.
+ */
+int fleet_scan_emergency(int em_id, int* out);
+
+#endif // FLEET_H
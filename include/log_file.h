@@ -0,0 +1,55 @@
+#ifndef LOG_FILE_H
+#define LOG_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Apre il file di log in append, preparando il buffer di scrittura.
+ *
+ * Il log attivo è sempre il file indicato; i segmenti chiusi vengono rinominati
+ * in <path>.<n> (n crescente, il più recente ha il numero più alto) e compressi in background.
+ *
+ * @param path Percorso del file di log attivo (es. "system.log").
+ * @return 0 in caso di successo, -1 se il file non può essere aperto.
+ */
+int log_file_open(const char* path);
+
+/**
+ * @brief Aggiunge una riga al buffer del file di log (formato printf).
+ *
+ * Il buffer viene scritto su disco quando è pieno o quando scade l'intervallo di flush (vedi log_file_tick).
+ */
+void log_file_printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Indicizza la prossima riga scritta nel log sotto l'entità indicata (vedi log_index.h).
+ *
+ * Va chiamata prima di log_file_printf, una volta per ogni entità a cui la riga si riferisce.
+ * La chiave registrata contiene anche il numero dell'esecuzione corrente, scelto all'apertura
+ * del log come successivo all'ultimo registrato negli indici già presenti.
+ *
+ * @param entity_class Classe dell'entità (LOG_ENTITY_EMERGENCY o LOG_ENTITY_RESCUER).
+ * @param entity_id ID dell'entità.
+ * @param timestamp_ms Istante dell'evento in millisecondi.
+ */
+void log_file_index(int entity_class, int entity_id, long long timestamp_ms);
+
+/**
+ * @brief Applica le politiche temporali: flush dei dati in attesa da troppo tempo e rotazione per età.
+ * Va chiamata periodicamente dal thread logger.
+ */
+void log_file_tick();
+
+/**
+ * @brief Tempo massimo (ms) che il thread logger può attendere prima di dover chiamare log_file_tick.
+ * @return -1 se il buffer è vuoto e non c'è nulla da fare finché non arrivano nuovi messaggi.
+ */
+int log_file_wait_ms();
+
+/**
+ * @brief Scrive su disco i dati rimasti nel buffer e chiude il file di log.
+ */
+void log_file_close();
+
+#endif // LOG_FILE_H
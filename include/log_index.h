@@ -0,0 +1,53 @@
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include <stdint.h>
+
+/**
+ * @brief Formato dell'indice affiancato a ogni segmento di log (<segmento>.idx).
+ *
+ * L'indice associa ogni riga che riguarda un'entità (emergenza o soccorritore) all'offset
+ * della riga nel segmento non compresso. Gli ID delle entità ripartono da 0 a ogni avvio del
+ * backend mentre il log prosegue in append: la chiave contiene anche il numero dell'esecuzione. L'indice del log attivo è in ordine di scrittura;
+ * quando il segmento viene chiuso l'indice viene ordinato per (entità, tempo, offset),
+ * così da poter essere interrogato con una ricerca binaria.
+ */
+
+// Lunghezza massima di una riga di log (le righe più lunghe vengono troncate dal logger)
+#define LOG_LINE_MAX 1024
+
+#define LOG_INDEX_MAGIC "EMLOGIDX"
+#define LOG_INDEX_VERSION 3
+
+// Classi di entità indicizzate
+#define LOG_ENTITY_EMERGENCY 1
+#define LOG_ENTITY_RESCUER 2
+
+// Numero massimo di un'esecuzione nella chiave (poi riparte da 1)
+#define LOG_RUN_MAX 0xFFFFFF
+
+// Chiave a 64 bit di un'entità: classe negli 8 bit alti, esecuzione nei 24 successivi, ID (mai troncato) nei 32 bassi
+#define LOG_ENTITY_KEY(cls, run, id) (((uint64_t)(cls) << 56) | ((uint64_t)((run) & LOG_RUN_MAX) << 32) | (uint32_t)(id))
+
+/**
+ * @brief Intestazione del file di indice.
+ */
+typedef struct {
+    char magic[8];          // LOG_INDEX_MAGIC (senza terminatore)
+    uint32_t version;       // LOG_INDEX_VERSION
+    uint32_t sorted;        // 1 se le voci sono ordinate per (entità, tempo, offset)
+    uint32_t first_run;     // Prima esecuzione del backend con righe nel segmento
+    uint32_t last_run;      // Ultima esecuzione del backend con righe nel segmento
+    int64_t created_ms;     // Creazione del segmento (ms dall'epoch): l'età sopravvive ai riavvii
+} log_index_header_t;
+
+/**
+ * @brief Voce dell'indice: una riga del segmento relativa a un'entità.
+ */
+typedef struct {
+    uint64_t entity;        // Chiave dell'entità (LOG_ENTITY_KEY)
+    int64_t timestamp_ms;   // Istante dell'evento in millisecondi
+    uint64_t offset;        // Offset della riga nel segmento non compresso
+} log_index_entry_t;
+
+#endif // LOG_INDEX_H
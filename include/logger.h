@@ -3,8 +3,41 @@
 
 #include <stdio.h>
 
+/**
+ * @brief Tipi di evento strutturato: sono quelli inoltrati anche al server TCP in formato JSON.
+ */
+typedef enum {
+    LOG_RESCUER_INIT,       // Creazione del gemello digitale di un soccorritore
+    LOG_EMERGENCY_INIT,     // Emergenza aggiunta alla coda
+    LOG_RESCUER_STATUS,     // Cambio di stato di un soccorritore
+    LOG_EMERGENCY_STATUS    // Cambio di stato di un'emergenza
+} log_kind_t;
+
+/**
+ * @brief Evento di log strutturato.
+ * I campi vengono copiati così come sono nella coda di log: la formattazione in testo
+ * (system.log) e in JSON (server TCP) avviene una sola volta, nel thread logger.
+ */
+typedef struct {
+    log_kind_t kind;        // Tipo di evento
+    int error;              // 1 se l'evento segnala un errore (ID "1xxx"), 0 altrimenti (ID "0xxx")
+    int entity_id;          // ID dell'emergenza o del soccorritore
+    int emergency_id;       // Emergenza gestita (solo RESCUER_STATUS diversi da IDLE)
+    const char* type_name;  // Nome del tipo (soccorritore o emergenza), deve restare valido per tutta l'esecuzione
+    int status;             // rescuer_status_t o emergency_status_t, a seconda del tipo di evento
+    int x, y;               // Posizione di riferimento dell'evento
+    int from_x, from_y;     // Partenza dello spostamento (RESCUER_STATUS in viaggio)
+    int to_x, to_y;         // Arrivo dello spostamento (RESCUER_STATUS in viaggio)
+    int duration;           // Durata della fase in secondi (RESCUER_STATUS)
+} log_record_t;
+
 void start_logger_thread();
 void stop_logger_thread();
 void log_event(const char* id, const char* event, const char* message);
+void log_emergency_event(int emergency_id, const char* id, const char* event, const char* message);
+void log_rescuer_event(int rescuer_id, const char* id, const char* event, const char* message);
+void log_record(const log_record_t* record);
+void log_set_clock(long long (*now_ms)(void));
+unsigned long log_dropped_count();
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,48 @@
+#ifndef MOVEMENT_H
+#define MOVEMENT_H
+
+#include "sim_clock.h"
+
+/**
+ * @brief Motore di movimento: posizione continua dei soccorritori in viaggio.
+ *
+ * La macchina a stati del soccorritore registra un tratto (partenza, arrivo, durata) quando
+ * il soccorritore parte e lo chiude quando arriva. Un timer del motore ad eventi avanza a passo
+ * fisso la posizione di tutti i soccorritori in movimento, con una sola passata su un array
+ * contiguo, e la pubblica negli array della flotta (fleet.h), da cui scheduler e altri lettori
+ * la leggono senza acquisire il mutex del soccorritore. Il timer gira solo mentre c'è almeno
+ * un soccorritore in movimento.
+ */
+
+// Passo di avanzamento delle posizioni in millisecondi di tempo virtuale
+#define MOVEMENT_TICK_MS 100
+
+/**
+ * @brief Prepara i tratti di viaggio di tutti i soccorritori (indicizzati per ID del gemello digitale).
+ *
+ * @param unit_count Numero totale di soccorritori.
+ */
+void movement_init(int unit_count);
+
+/**
+ * @brief Registra un tratto di viaggio di un soccorritore (sostituisce quello eventualmente in corso).
+ *
+ * @param id ID del gemello digitale.
+ * @param from_x Coordinata X di partenza.
+ * @param from_y Coordinata Y di partenza.
+ * @param to_x Coordinata X di arrivo.
+ * @param to_y Coordinata Y di arrivo.
+ * @param duration_ms Durata del viaggio in millisecondi di tempo virtuale.
+ */
+void movement_start(int id, int from_x, int from_y, int to_x, int to_y, sim_time_t duration_ms);
+
+/**
+ * @brief Ferma un soccorritore in un punto (fine del viaggio, richiamo o posizione iniziale).
+ *
+ * @param id ID del gemello digitale.
+ * @param x Coordinata X.
+ * @param y Coordinata Y.
+ */
+void movement_stop(int id, int x, int y);
+
+#endif // MOVEMENT_H
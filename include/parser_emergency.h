@@ -3,6 +3,18 @@
 
 #include "types.h"
 
+/**
+ * @brief Indice hash (indirizzamento aperto) dei tipi di emergenza per nome.
+ * Costruito una sola volta dopo il caricamento, permette di validare il nome
+ * ricevuto dalla message queue in tempo costante indipendentemente dal numero di tipi.
+ */
+typedef struct {
+    unsigned int* hashes;       // Hash del nome memorizzato in ciascuno slot
+    int* slots;                 // Indice nell'array dei tipi (-1 = slot vuoto)
+    unsigned int mask;          // Capacità - 1 (la capacità è una potenza di 2)
+    emergency_type_t* types;    // Array dei tipi indicizzati
+} emergency_type_index_t;
+
 int load_emergency_types(
     const char* filename,
     emergency_type_t** out_types,
@@ -11,4 +23,15 @@ int load_emergency_types(
     int known_types_count
 );
 
+int emergency_type_index_build(
+    emergency_type_index_t* index,
+    emergency_type_t* types,
+    int count
+);
+
+emergency_type_t* emergency_type_index_find(
+    const emergency_type_index_t* index,
+    const char* name
+);
+
 #endif // PARSER_EMERGENCY_H
\ No newline at end of file
@@ -4,10 +4,88 @@
 #include "types.h"
 
 /**
- * @brief Avvia i thread dei gemelli digitali dei soccorritori.
+ * @brief Inizializza lo stato di runtime del gemello digitale di un soccorritore.
  * 
- * @param rescuers Array di soccorritori digitali
- * @param count Numero totale di soccorritori
+ * Le transizioni di stato del soccorritore vengono eseguite come callback dei timer
+ * del motore ad eventi, senza un thread dedicato.
+ * 
+ * @param rescuer_wrapped Soccorritore da inizializzare
  */
 void start_rescuer(rescuer_thread_t* rescuer_wrapped);
+
+/**
+ * @brief Invia un soccorritore (già prelevato dal pool dei liberi) verso un'emergenza.
+ * 
+ * Un soccorritore in rientro alla base parte direttamente dal punto raggiunto.
+ * 
+ * @param rescuer_wrapped Soccorritore da inviare
+ * @param em Emergenza da gestire
+ * @param slot Posto del soccorritore nella squadra (indice in em->slots), da cui dipende il tempo di intervento residuo
+ */
+void rescuer_dispatch(rescuer_thread_t* rescuer_wrapped, emergency_t* em, int slot);
+
+/**
+ * @brief Posizione attuale di un soccorritore.
+ * 
+ * Anche durante un viaggio la posizione è quella aggiornata dal motore di movimento all'ultimo
+ * passo (movement.h), letta dagli array della flotta (fleet.h) senza acquisire il mutex del soccorritore.
+ * 
+ * @param rescuer_wrapped Soccorritore
+ * @param x Restituisce la coordinata X
+ * @param y Restituisce la coordinata Y
+ */
+void rescuer_position(const rescuer_thread_t* rescuer_wrapped, int* x, int* y);
+
+/**
+ * @brief Imposta il comportamento dei soccorritori a fine intervento (env.conf: return_to_base).
+ * 
+ * @param enabled 1 se rientrano alla base (default), 0 se restano liberi sul luogo dell'intervento
+ */
+void rescuer_set_return_to_base(int enabled);
+
+/**
+ * @brief Indica se i soccorritori rientrano alla base a fine intervento.
+ * 
+ * @return 1 se rientrano alla base, 0 se restano liberi sul luogo dell'intervento
+ */
+int rescuer_returns_to_base(void);
+
+/**
+ * @brief Prepara il richiamo dei soccorritori impegnati su un'emergenza in corso (prelazione).
+ * 
+ * Blocca i soccorritori e ne ferma i timer senza ancora sospendere l'emergenza: una prelazione
+ * con più vittime prepara tutti i richiami e sospende le vittime solo se riescono tutti.
+ * 
+ * @param em Emergenza IN_PROGRESS da sospendere
+ * @param em_id ID atteso dell'emergenza (il record di em può essere stato riciclato nel frattempo)
+ * @param units Tutti i soccorritori ancora impegnati sull'emergenza (in viaggio o sulla scena)
+ * @param n Numero di soccorritori
+ * @param remaining Restituisce il tempo residuo (ms) della fase interrotta di ogni soccorritore
+ * @return 0 se il richiamo è pronto (soccorritori bloccati), -1 se l'emergenza è cambiata nel frattempo (nessuna modifica)
+ */
+int rescuer_preempt_prepare(emergency_t* em, int em_id, rescuer_thread_t** units, int n, sim_time_t* remaining);
+
+/**
+ * @brief Annulla un richiamo preparato: i soccorritori riprendono la fase interrotta.
+ * 
+ * @param units Soccorritori passati a rescuer_preempt_prepare
+ * @param n Numero di soccorritori
+ * @param remaining Tempi residui restituiti da rescuer_preempt_prepare
+ */
+void rescuer_preempt_abort(rescuer_thread_t** units, int n, const sim_time_t* remaining);
+
+/**
+ * @brief Completa un richiamo preparato: sospende l'emergenza (PAUSED) e libera i soccorritori.
+ * 
+ * L'intervento svolto viene accreditato posto per posto; i soccorritori richiamati rientrano alla
+ * base (se previsto da return_to_base) e tornano subito assegnabili.
+ * 
+ * @param em Emergenza da sospendere
+ * @param em_id ID dell'emergenza
+ * @param units Soccorritori passati a rescuer_preempt_prepare
+ * @param n Numero di soccorritori
+ * @param remaining Tempi residui restituiti da rescuer_preempt_prepare
+ * @param work_done Restituisce i secondi di intervento svolti dall'ultima ripresa (il massimo tra i posti)
+ */
+void rescuer_preempt_commit(emergency_t* em, int em_id, rescuer_thread_t** units, int n, const sim_time_t* remaining, int* work_done);
 #endif // RESCUER_H
\ No newline at end of file
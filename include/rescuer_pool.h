@@ -0,0 +1,68 @@
+#ifndef RESCUER_POOL_H
+#define RESCUER_POOL_H
+
+#include "types.h"
+
+/**
+ * @brief Inizializza un pool (vuoto) di soccorritori liberi per ogni tipo di soccorritore.
+ * 
+ * Ogni pool indicizza i soccorritori liberi in una griglia uniforme che copre la mappa.
+ * 
+ * @param types Array dei tipi di soccorritore caricati da file.
+ * @param type_count Numero di tipi di soccorritore.
+ * @param width Larghezza della mappa.
+ * @param height Altezza della mappa.
+ */
+void rescuer_pool_init(rescuer_type_info_t* types, int type_count, int width, int height);
+
+/**
+ * @brief Inserisce un soccorritore libero nel pool del suo tipo, nella sua posizione attuale.
+ * 
+ * Sono liberi i soccorritori IDLE e quelli in rientro alla base, che possono essere inviati
+ * direttamente a una nuova emergenza: questi ultimi sono valutati, a ogni ricerca, nel punto
+ * raggiunto durante il rientro.
+ * 
+ * @param r Soccorritore tornato disponibile.
+ */
+void rescuer_pool_put(rescuer_thread_t* r);
+
+/**
+ * @brief Sposta un soccorritore ancora nel pool nella sua posizione attuale (es. rientro alla base completato).
+ * 
+ * Non fa nulla se il soccorritore è stato prelevato nel frattempo.
+ * 
+ * @param r Soccorritore che ha cambiato posizione.
+ */
+void rescuer_pool_relocate(rescuer_thread_t* r);
+
+/**
+ * @brief Preleva gli n soccorritori liberi del tipo indicato più vicini a un punto (tutti o nessuno).
+ * 
+ * @param type_id ID del tipo di soccorritore richiesto.
+ * @param n Numero di soccorritori richiesti.
+ * @param x Coordinata X dell'emergenza.
+ * @param y Coordinata Y dell'emergenza.
+ * @param out Array in cui scrivere i soccorritori prelevati (almeno n elementi), dal più vicino.
+ * @return 0 se sono stati prelevati tutti gli n soccorritori, -1 altrimenti (nessuno prelevato).
+ */
+int rescuer_pool_take_nearest(int type_id, int n, int x, int y, rescuer_thread_t** out);
+
+/**
+ * @brief Preleva tutti i soccorritori liberi del tipo indicato (al più max).
+ * 
+ * @param type_id ID del tipo di soccorritore.
+ * @param out Array in cui scrivere i soccorritori prelevati (almeno max elementi).
+ * @param max Numero massimo di soccorritori da prelevare.
+ * @return Numero di soccorritori prelevati.
+ */
+int rescuer_pool_take_all(int type_id, rescuer_thread_t** out, int max);
+
+/**
+ * @brief Numero di soccorritori liberi del tipo indicato.
+ * 
+ * @param type_id ID del tipo di soccorritore.
+ * @return Numero di soccorritori liberi (0 se il tipo non esiste).
+ */
+int rescuer_pool_idle_count(int type_id);
+
+#endif // RESCUER_POOL_H
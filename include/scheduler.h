@@ -18,6 +18,7 @@ int scheduler_thread_fun(void* arg);
 typedef struct {
     rescuer_thread_t* rescuers;
     int rescuer_count;
+    int batch_window_ms;    // Finestra di raccolta delle emergenze in ms (0 = assegnamento greedy una alla volta)
 } scheduler_args_t;
 
 #endif
@@ -0,0 +1,67 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include "types.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * @brief Ring in memoria condivisa per l'invio delle emergenze dai client al backend.
+ *
+ * Alternativa alla message queue POSIX: il client scrive la richiesta direttamente nello
+ * slot del ring (nessuna copia nel kernel, nessuna syscall se il backend è sveglio) e il
+ * backend la legge sul posto. Gli slot usano lo schema a numeri di sequenza già usato
+ * dalla coda di log, quindi più client (e più thread dello stesso client) possono
+ * scrivere contemporaneamente senza lock. Le attese usano futex condivisi tra processi.
+ */
+
+#define SHM_RING_MAGIC 0x454d524eu   // "EMRN"
+
+/**
+ * @brief Slot del ring: numero di sequenza e richiesta di emergenza.
+ */
+typedef struct {
+    _Atomic uint64_t seq;           // pos = libero per la scrittura, pos+1 = pubblicato
+    emergency_request_t req;        // Richiesta scritta dal client
+} shm_ring_slot_t;
+
+/**
+ * @brief Intestazione del ring, seguita dagli slot nello stesso segmento di memoria condivisa.
+ * Indici e parole futex stanno su linee di cache diverse per non rimbalzare tra produttori e consumatore.
+ */
+typedef struct {
+    uint32_t magic;                                 // SHM_RING_MAGIC, scritto per ultimo dal backend
+    uint32_t capacity;                              // Numero di slot (potenza di 2)
+    int32_t backend_pid;                            // PID del backend che ha creato il ring
+    _Alignas(64) _Atomic uint64_t head;             // Prossima posizione da riservare (produttori)
+    _Alignas(64) _Atomic uint64_t tail;             // Prossima posizione da leggere (backend)
+    _Alignas(64) _Atomic uint32_t data_seq;         // Futex: incrementato quando arrivano dati
+    _Atomic uint32_t consumer_waiting;              // 1 se il backend dorme su data_seq
+    _Alignas(64) _Atomic uint32_t space_seq;        // Futex: incrementato quando si libera spazio
+    _Atomic uint32_t producers_waiting;             // Produttori che dormono su space_seq
+    _Alignas(64) shm_ring_slot_t slots[];
+} shm_ring_shared_t;
+
+/**
+ * @brief Ring aperto da un processo: il segmento condiviso più la sua capacità in memoria locale.
+ * La capacità viene validata una sola volta all'apertura; gli indici degli slot usano solo la copia
+ * locale, così un altro processo che scrive nel segmento non può portarli fuori dalla mappatura.
+ */
+typedef struct {
+    shm_ring_shared_t* shared;      // Segmento mappato
+    uint32_t capacity;              // Numero di slot (potenza di 2)
+    uint32_t mask;                  // capacity - 1
+} shm_ring_t;
+
+shm_ring_t* shm_ring_create(const char* name, int capacity);
+shm_ring_t* shm_ring_open(const char* name);
+void shm_ring_close(shm_ring_t* ring);
+
+emergency_request_t* shm_ring_reserve(shm_ring_t* ring, uint64_t* pos);
+void shm_ring_publish(shm_ring_t* ring, uint64_t pos);
+
+emergency_request_t* shm_ring_peek(shm_ring_t* ring);
+void shm_ring_release(shm_ring_t* ring);
+void shm_ring_wait(shm_ring_t* ring);
+
+#endif // SHM_RING_H
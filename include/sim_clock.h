@@ -0,0 +1,82 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+/**
+ * @brief Tempo virtuale della simulazione, in millisecondi dall'epoch.
+ */
+typedef long long sim_time_t;
+
+/**
+ * @brief Timer del motore ad eventi: alla scadenza la callback viene eseguita da un worker.
+ * La struttura è di proprietà del chiamante (tipicamente incorporata nell'oggetto che la usa),
+ * quindi programmare o annullare un timer non richiede allocazioni.
+ */
+typedef struct sim_timer {
+    long long expires;              // Tick virtuale di scadenza
+    void (*callback)(void* arg);    // Funzione da eseguire alla scadenza
+    void* arg;                      // Argomento della callback
+    struct sim_timer* next;         // Collegamenti nello slot della ruota o nella coda dei pronti
+    struct sim_timer* prev;
+    int level;                      // Livello della ruota in cui è registrato
+    int slot;                       // Slot della ruota in cui è registrato
+    int state;                      // Stato del timer (inattivo, in ruota, pronto, in esecuzione)
+} sim_timer_t;
+
+/**
+ * @brief Avvia il motore ad eventi discreti: orologio virtuale, ruota dei timer e pool di worker.
+ *
+ * @param time_scale Fattore di accelerazione del tempo virtuale rispetto a quello reale
+ *                   (1 = tempo reale, 1000 = mille volte più veloce, 0 = il più veloce possibile:
+ *                   il tempo salta direttamente al timer successivo appena i worker sono fermi).
+ * @param workers Numero di thread worker che eseguono le callback dei timer.
+ */
+void sim_init(double time_scale, int workers);
+
+/**
+ * @brief Restituisce l'istante corrente del tempo virtuale.
+ */
+sim_time_t sim_now();
+
+/**
+ * @brief Prepara un timer associandogli la callback da eseguire alla scadenza.
+ */
+void sim_timer_init(sim_timer_t* timer, void (*callback)(void* arg), void* arg);
+
+/**
+ * @brief Programma un timer dopo un intervallo di tempo virtuale (riprogrammandolo se già attivo).
+ *
+ * @param timer Timer inizializzato con sim_timer_init.
+ * @param delay_ms Ritardo in millisecondi virtuali.
+ */
+void sim_schedule(sim_timer_t* timer, sim_time_t delay_ms);
+
+/**
+ * @brief Segnala che un thread esterno al pool di worker sta modificando lo stato della simulazione.
+ *
+ * Nella modalità "il più veloce possibile" il tempo virtuale non avanza finché il lavoro
+ * non viene chiuso con sim_release (come per le callback in esecuzione).
+ */
+void sim_hold();
+
+/**
+ * @brief Chiude il lavoro aperto con sim_hold.
+ */
+void sim_release();
+
+/**
+ * @brief Annulla un timer non ancora eseguito.
+ *
+ * @return 0 se il timer è stato annullato, -1 se non era programmato o è già in esecuzione.
+ */
+int sim_cancel(sim_timer_t* timer);
+
+/**
+ * @brief Annulla un timer non ancora eseguito e restituisce il tempo che mancava alla scadenza.
+ *
+ * @param timer Timer da annullare.
+ * @param remaining_ms Restituisce i millisecondi virtuali mancanti alla scadenza (0 se già scaduto).
+ * @return 0 se il timer è stato annullato, -1 se non era programmato o è già in esecuzione.
+ */
+int sim_cancel_remaining(sim_timer_t* timer, sim_time_t* remaining_ms);
+
+#endif // SIM_CLOCK_H
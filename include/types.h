@@ -3,8 +3,10 @@
 
 #include <time.h>
 #include <threads.h>
+#include "sim_clock.h"
 #define EMERGENCY_NAME_LENGTH 64
 #define MAX_QUEUE_NAME 16
+#define MAX_CACHE_DIR 200
 
 
 //TIPI E ISTANZE DI SOCCORRITORI
@@ -25,7 +27,8 @@ typedef enum {
  * Questi dati vengono caricati dal file rescuers.conf
  */
 typedef struct {
-    char* rescuer_type_name;   // Nome identificativo del tipo di soccorritore
+    int id;                    // Identificativo numerico denso del tipo (indice di caricamento)
+    char* rescuer_type_name;   // Nome identificativo del tipo di soccorritore (solo per log e visualizzazione)
     int speed;                 // Velocità di movimento (unità/tempo)
     int x;                     // Coordinata X della base operativa
     int y;                     // Coordinata Y della base operativa
@@ -37,8 +40,8 @@ typedef struct {
  */
 typedef struct {
     int id;                    // Identificativo univoco del soccorritore
-    int x;                     // Posizione X corrente
-    int y;                     // Posizione Y corrente
+    int x;                     // Posizione X dell'ultima sosta (in viaggio quella attuale è in movement.h)
+    int y;                     // Posizione Y dell'ultima sosta
     rescuer_type_t* rescuer;   // Puntatore al tipo di soccorritore
     rescuer_status_t status;   // Stato corrente del soccorritore
 } rescuer_digital_twin_t;
@@ -52,6 +55,7 @@ typedef struct {
  * Specifica il tipo e il numero di soccorritori necessari
  */
 typedef struct {
+    int type_id;                    // Identificativo del tipo di soccorritore richiesto
     rescuer_type_t* type;    // Tipo di soccorritore richiesto
     int required_count;             // Numero di soccorritori necessari
     int time_to_manage;             // Tempo necessario per gestire l'emergenza
@@ -62,10 +66,12 @@ typedef struct {
  * Questi dati vengono caricati dal file emergency_types.conf
  */
 typedef struct {
+    int id;                         // Identificativo numerico denso del tipo di emergenza
     short priority;                 // Livello di priorità dell'emergenza
-    char* emergency_desc;           // Descrizione dell'emergenza
+    char* emergency_desc;           // Descrizione dell'emergenza (solo per log e visualizzazione)
     rescuer_request_t* rescuers;    // Array di richieste di soccorritori
-    int rescuers_req_number;        // Numero totale di soccorritori richiesti
+    int rescuers_req_number;        // Numero di richieste (tipi di soccorritore distinti)
+    int rescuers_total;             // Numero totale di soccorritori richiesti (somma dei required_count)
 } emergency_type_t;
 
 
@@ -97,21 +103,39 @@ typedef struct {
     time_t timestamp;                           ///< Timestamp di ricezione della richiesta
 } emergency_request_t;
 
+// Coordinata massima rappresentabile in un'emergenza (le coordinate sono memorizzate su 16 bit)
+#define EMERGENCY_COORD_MAX 65535
+
+/**
+ * @brief Posto nella squadra di un'emergenza: i posti seguono l'ordine delle richieste del tipo
+ * (i primi required_count per la prima richiesta, e così via).
+ */
+typedef struct {
+    rescuer_digital_twin_t* twin;              ///< Soccorritore assegnato al posto (NULL se mai assegnato)
+    unsigned short work_done;                  ///< Secondi di intervento già svolti nel posto prima di una sospensione (PAUSED)
+} emergency_slot_t;
+
 /**
- * @brief Rappresentazione completa di un'emergenza in gestione
- * Include informazioni dettagliate derivate dal tipo, lo stato corrente,
- * le coordinate, il tempo, e i soccorritori assegnati.
+ * @brief Rappresentazione compatta di un'emergenza in gestione
+ * I dati del tipo non vengono copiati: l'emergenza punta alla tabella dei tipi, condivisa
+ * e in sola lettura. I campi letti dalla coda (priorità e sequenza) stanno in testa, l'elenco
+ * dei soccorritori assegnati è in coda alla struttura ed è dimensionato sul tipo (vedi emergency_pool.h).
+ * La mutua esclusione è data da un lock a strisce esterno (vedi emergency_status.c).
  */
 typedef struct {
+    const emergency_type_t* type;              ///< Tipo di emergenza (tabella condivisa, in sola lettura)
+    unsigned long queue_seq;                   ///< Numero di sequenza di arrivo (a parità di priorità vince il più vecchio)
+    long long waiting_since;                   ///< Istante virtuale (ms) della prima attesa di soccorritori (0 se mai in attesa)
+    int queue_index;                           ///< Slot occupato nell'heap della coda (-1 se non in coda)
     int id;                                    ///< Identificativo univoco dell’emergenza (AGGIUNTO PER COMODITÀ)
-    emergency_type_t type;                     ///< Tipo di emergenza (caricato da file)
-    emergency_status_t status;                 ///< Stato attuale dell’emergenza
-    int x;                                     ///< Coordinata X dell’emergenza
-    int y;                                     ///< Coordinata Y dell’emergenza
-    time_t time;                               ///< Tempo di inizio della gestione
-    int rescuer_count;                         ///< Numero di soccorritori assegnati
-    rescuer_digital_twin_t** rescuers_dt;      ///< Puntatore all’elenco dei soccorritori assegnati
-    mtx_t mutex;                     ///< Mutex per la sincronizzazione dell'accesso         
+    short priority;                            ///< Priorità corrente (inizialmente quella del tipo)
+    unsigned char status;                      ///< Stato attuale dell’emergenza (emergency_status_t)
+    unsigned short x;                          ///< Coordinata X dell’emergenza
+    unsigned short y;                          ///< Coordinata Y dell’emergenza
+    unsigned short rescuer_count;              ///< Numero di soccorritori assegnati
+    unsigned short rescuers_busy;              ///< Soccorritori assegnati che non hanno ancora terminato l'intervento
+    unsigned short time;                       ///< Tempo stimato di gestione in secondi
+    emergency_slot_t slots[];                  ///< Posti della squadra (rescuer_count elementi)
 } emergency_t;
 
 //AGGIUNTI
@@ -120,23 +144,44 @@ typedef struct {
     int count;                      // Numero di soccorritori
 } rescuer_type_info_t;
 
+/**
+ * @brief Canale con cui i client inviano le emergenze al backend.
+ */
+typedef enum {
+    TRANSPORT_MQ,           // Message queue POSIX (default)
+    TRANSPORT_SHM           // Ring in memoria condivisa (shm_ring.h)
+} transport_t;
+
 typedef struct {
     char queue[MAX_QUEUE_NAME];
     int height;
     int width;
+    int queue_soft_limit;   // Emergenze in coda oltre le quali viene segnalata congestione (0 = disattivato)
+    int queue_hard_limit;   // Emergenze in coda oltre le quali il ricevitore smette di leggere (0 = illimitata)
+    int queue_depth;        // Capacità della message queue POSIX (o del ring condiviso) in messaggi
+    transport_t transport;  // Canale di ingresso delle emergenze
+    int return_to_base;     // 1 se i soccorritori rientrano alla base dopo l'intervento, 0 se restano sul posto
+    char eta_cache_dir[MAX_CACHE_DIR]; // Directory dei file di cache delle tabelle ETA
 } env_config_t;
 
 
 /**
- * @brief Struttura che rappresenta un soccorritore in un thread
- * Contiene il gemello digitale del soccorritore e le informazioni sul thread
+ * @brief Struttura che rappresenta lo stato di runtime di un soccorritore
+ * Contiene il gemello digitale del soccorritore e il timer che ne guida le transizioni di stato
  */
-typedef struct {
+typedef struct rescuer_thread {
     rescuer_digital_twin_t* twin;     // Gemello digitale originale
     mtx_t mutex;            // Mutex personale
-    cnd_t cond;              // Condition var personale
-    thrd_t thread;                 // Thread associato
+    sim_timer_t timer;                // Timer della fase corrente (viaggio, intervento, rientro)
+    int travel_time;                  // Durata del viaggio verso l'emergenza corrente (secondi)
+    int emergency_time;               // Durata dell'intervento sull'emergenza corrente (secondi)
     emergency_t* current_em;          // Emergenza corrente
+    int slot;                         // Posto occupato nella squadra dell'emergenza corrente
+    int return_time;                  // Durata del rientro alla base in corso (secondi)
+    int stale_step;                   // 1 se la callback del timer già partita va ignorata (rientro interrotto)
+    struct rescuer_thread* next_idle; // Prossimo soccorritore libero nella stessa posizione (lista intrusiva del pool)
+    struct rescuer_thread* prev_idle; // Precedente soccorritore libero nella stessa posizione
+    struct idle_spot* idle_spot;      // Posizione del pool in cui è registrato (NULL se non libero)
 } rescuer_thread_t;
 
 #endif // TYPES_H
\ No newline at end of file
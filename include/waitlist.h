@@ -0,0 +1,52 @@
+#ifndef WAITLIST_H
+#define WAITLIST_H
+
+#include "types.h"
+
+/**
+ * @brief Liste d'attesa delle emergenze rimaste senza soccorritori liberi, una per tipo di soccorritore.
+ *
+ * Un'emergenza che non trova abbastanza soccorritori liberi di un tipo, ma può ancora essere
+ * gestita entro il suo tempo massimo, viene parcheggiata nella lista del tipo mancante invece
+ * di andare in TIMEOUT. Quando un soccorritore di quel tipo torna libero (rescuer_pool_put)
+ * le emergenze in testa alla lista che ora possono essere servite tornano nella coda dello
+ * scheduler. Un timer del motore ad eventi scarta l'emergenza quando il tempo massimo non è
+ * più rispettabile. Nessun controllo periodico: tutto avviene sugli eventi.
+ */
+
+/**
+ * @brief Inizializza una lista d'attesa (vuota) per ogni tipo di soccorritore.
+ *
+ * @param types Array dei tipi di soccorritore caricati da file (con il numero di soccorritori di ogni tipo).
+ * @param type_count Numero di tipi di soccorritore.
+ */
+void waitlist_init(rescuer_type_info_t* types, int type_count);
+
+/**
+ * @brief Parcheggia un'emergenza in attesa dei soccorritori di un tipo.
+ *
+ * Le emergenze in attesa sono ordinate per priorità e, a parità, per ordine di arrivo.
+ *
+ * @param e Emergenza (in stato WAITING, fuori dalla coda).
+ * @param req Richiesta dell'emergenza rimasta senza soccorritori liberi.
+ * @param max_time Tempo massimo di gestione in secondi (-1 se senza limite).
+ * @param min_time Secondi che serviranno comunque dopo l'attesa: viaggio dei soccorritori mancanti
+ *                 e intervento ancora da svolgere (calcolati dallo scheduler). La scadenza dell'attesa
+ *                 è max_time - min_time dall'inizio dell'attesa.
+ * @return 0 se l'emergenza è stata parcheggiata, -1 se non può attendere (tempo massimo non più
+ *         rispettabile o soccorritori del tipo insufficienti anche quando saranno tutti liberi).
+ */
+int waitlist_park(emergency_t* e, const rescuer_request_t* req, int max_time, int min_time);
+
+/**
+ * @brief Segnala che un soccorritore del tipo indicato è tornato libero.
+ *
+ * Rimette nella coda dello scheduler, in ordine, le emergenze in attesa che possono essere
+ * servite con i soccorritori liberi. Senza emergenze in attesa non acquisisce alcun lock.
+ *
+ * @param type_id ID del tipo di soccorritore.
+ * @param idle_count Numero di soccorritori liberi del tipo.
+ */
+void waitlist_notify(int type_id, int idle_count);
+
+#endif // WAITLIST_H
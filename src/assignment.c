@@ -0,0 +1,81 @@
+#include "assignment.h"
+#include "macros.h"
+#include <stdlib.h>
+#include <limits.h>
+
+int assignment_solve(int n, int m, const long long* cost, int* row_to_col) {
+    if (n > m) return -1;
+    if (n == 0) return 0;
+
+    // Potenziali di righe (u) e colonne (v), abbinamento colonna->riga (p, 1-based, 0 = libera),
+    // colonna precedente nel cammino aumentante (way), minimi correnti (minv), colonne visitate (used)
+    long long* u = calloc(n + 1, sizeof(long long));
+    long long* v = calloc(m + 1, sizeof(long long));
+    long long* minv = malloc((m + 1) * sizeof(long long));
+    int* p = calloc(m + 1, sizeof(int));
+    int* way = calloc(m + 1, sizeof(int));
+    char* used = malloc(m + 1);
+    int result = -1;
+    CHECK_MALLOC(u, fail);
+    CHECK_MALLOC(v, fail);
+    CHECK_MALLOC(minv, fail);
+    CHECK_MALLOC(p, fail);
+    CHECK_MALLOC(way, fail);
+    CHECK_MALLOC(used, fail);
+
+    // Aggiunge una riga alla volta, cercando un cammino aumentante di costo ridotto minimo
+    for (int i = 1; i <= n; i++) {
+        p[0] = i;
+        int j0 = 0;
+        for (int j = 0; j <= m; j++) {
+            minv[j] = LLONG_MAX;
+            used[j] = 0;
+        }
+        do {
+            used[j0] = 1;
+            int i0 = p[j0], j1 = 0;
+            long long delta = LLONG_MAX;
+            for (int j = 1; j <= m; j++) {
+                if (used[j]) continue;
+                long long cur = cost[(size_t)(i0 - 1) * m + (j - 1)] - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            // Aggiorna i potenziali: le colonne visitate restano a costo ridotto nullo
+            for (int j = 0; j <= m; j++) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        // Inverte il cammino aumentante trovato
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    for (int j = 1; j <= m; j++) {
+        if (p[j] != 0) row_to_col[p[j] - 1] = j - 1;
+    }
+    result = 0;
+    fail:
+    free(u);
+    free(v);
+    free(minv);
+    free(p);
+    free(way);
+    free(used);
+    return result;
+}
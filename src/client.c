@@ -8,6 +8,7 @@
 #include "parser_env.h"
 #include "types.h"
 #include "macros.h"
+#include "shm_ring.h"
 #include <threads.h>
 
 #define MAX_NAME_LEN 64
@@ -19,6 +20,7 @@ typedef struct {
     int y;
     int delay_sec;
     mqd_t mq;
+    shm_ring_t* ring;   // Ring condiviso (NULL se si usa la message queue)
 } emergency_to_send;
 
 /**
@@ -42,6 +44,7 @@ int send_emergency(void* arg) {
     int y = em->y;
     int delay_sec = em->delay_sec;
     mqd_t mq = em->mq;
+    shm_ring_t* ring = em->ring;
     free(em->name);
     free(em); // Libera la memoria allocata per l'emergenza
 
@@ -54,7 +57,18 @@ int send_emergency(void* arg) {
     sleep(delay_sec); // Simula il delay
     req.timestamp = time(NULL); // Imposta il timestamp corrente
 
-    if (mq_send(mq, (char*)&req, sizeof(req), 0) == -1) {
+    if (ring) {
+        // Scrive la richiesta direttamente nello slot del ring condiviso
+        uint64_t pos;
+        emergency_request_t* slot = shm_ring_reserve(ring, &pos);
+        if (!slot) {
+            perror("❌ shm_ring_reserve"); // Ring pieno e backend terminato
+        } else {
+            *slot = req;
+            shm_ring_publish(ring, pos);
+            printf("✅ Emergenza inviata: %s (%d,%d) %d(sec)\n", name, x, y,delay_sec);
+        }
+    } else if (mq_send(mq, (char*)&req, sizeof(req), 0) == -1) {
         perror("❌ mq_send");
     } else {
         printf("✅ Emergenza inviata: %s (%d,%d) %d(sec)\n", name, x, y,delay_sec);
@@ -63,6 +77,14 @@ int send_emergency(void* arg) {
     return 0;
 }
 
+/**
+ * @brief Chiude il canale verso il backend (message queue o ring condiviso).
+ */
+static void close_channel(mqd_t mq, shm_ring_t* ring) {
+    if (ring) shm_ring_close(ring);
+    else mq_close(mq);
+}
+
 int main(int argc, char* argv[]) {
     env_config_t env_config;
     load_env_config("./conf/env.conf", &env_config);
@@ -71,12 +93,22 @@ int main(int argc, char* argv[]) {
     strncpy(queue_name + 1, env_config.queue, strlen(env_config.queue));
     queue_name[strlen(env_config.queue) + 1] = '\0';
 
-    mqd_t mq;
+    mqd_t mq = (mqd_t)-1;
+    shm_ring_t* ring = NULL;
 
-    // Apre la coda dei messaggi
+    // Apre il canale verso il backend: ring condiviso o message queue
     printf("🔓 Apertura coda: %s\n", queue_name);
-    mq = mq_open(queue_name, O_WRONLY);
-    CHECK_MQ_OPEN(mq, queue_name);
+    if (env_config.transport == TRANSPORT_SHM) {
+        ring = shm_ring_open(queue_name);
+        if (!ring) {
+            printf("Errore aprendo il ring condiviso %s: %s\n", queue_name, strerror(errno));
+            printf("Avviare prima \"main\" poi \"client\"\n");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        mq = mq_open(queue_name, O_WRONLY);
+        CHECK_MQ_OPEN(mq, queue_name);
+    }
 
     // Modalità da file: invia emergenze lette da file riga per riga
     if (argc == 3 && strcmp(argv[1], "-f") == 0) {
@@ -84,7 +116,7 @@ int main(int argc, char* argv[]) {
         FILE* file = fopen(argv[2], "r");
         if (!file) {
             perror("❌ fopen");
-            mq_close(mq);
+            close_channel(mq, ring);
             return 1;
         }
         printf("📂 File aperto correttamente.\n");
@@ -112,6 +144,7 @@ int main(int argc, char* argv[]) {
                 em->y = y;
                 em->delay_sec = delay;
                 em->mq = mq;
+                em->ring = ring;
                 thrd_create(&threads[i++], send_emergency, (void*)em);
             } else {
                 fprintf(stderr, "❌ Riga ignorata (formato errato): %s\n", line);
@@ -142,6 +175,7 @@ int main(int argc, char* argv[]) {
         em->y = y;
         em->delay_sec = delay;
         em->mq = mq;
+        em->ring = ring;
         thrd_t thread;
         thrd_create(&thread, send_emergency, (void*)em);
         thrd_join(thread, NULL); // Aspetta che il thread finisca
@@ -152,10 +186,10 @@ int main(int argc, char* argv[]) {
     else {
         print_usage(argv[0]);  // Stampa l'uso corretto
         fail:
-        mq_close(mq);
+        close_channel(mq, ring);
         return 1;
     }
 
-    mq_close(mq);
+    close_channel(mq, ring);
     return 0;
 }
@@ -0,0 +1,105 @@
+#include "emergency_pool.h"
+#include "logger.h"
+#include "macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdalign.h>
+#include <string.h>
+#include <threads.h>
+
+// Numero di emergenze allocate in ogni blocco
+#define EMERGENCY_SLAB_SIZE 128
+
+/**
+ * @brief Classe di dimensione del pool: una per tipo di emergenza.
+ * Gli elementi di una classe hanno l'elenco dei soccorritori assegnati già dimensionato
+ * sul numero totale di soccorritori richiesti dal tipo.
+ */
+typedef struct {
+    const emergency_type_t* type;   // Tipo servito dalla classe
+    size_t item_size;               // Dimensione di un elemento (emergenza + elenco dei soccorritori)
+    emergency_t* free_list;         // Elementi liberi, collegati tramite il loro primo campo
+    int slab_count;                 // Blocchi allocati
+} pool_class_t;
+
+// Classi indicizzate per ID del tipo di emergenza
+static pool_class_t* classes = NULL;
+static int class_count = 0;
+
+// Mutex che protegge free list e contatori dei blocchi
+static mtx_t pool_mutex;
+
+/**
+ * @brief Collegamento nella free list: un elemento libero riusa il proprio primo campo.
+ */
+static emergency_t** free_link(emergency_t* e) {
+    return (emergency_t**)e;
+}
+
+void emergency_pool_init(emergency_type_t* types, int type_count) {
+    mtx_init(&pool_mutex, mtx_plain);
+    classes = calloc(type_count, sizeof(pool_class_t));
+    CHECK_MALLOC(classes, fail);
+    class_count = type_count;
+    for (int i = 0; i < type_count; i++) {
+        // types[i].id == i: le classi si indicizzano con l'ID del tipo
+        size_t size = sizeof(emergency_t) + types[i].rescuers_total * sizeof(emergency_slot_t);
+        classes[i].type = &types[i];
+        classes[i].item_size = (size + alignof(emergency_t) - 1) / alignof(emergency_t) * alignof(emergency_t);
+    }
+    return;
+    fail:
+    class_count = 0;
+}
+
+/**
+ * @brief Alloca un nuovo blocco di emergenze della classe e lo aggiunge alla sua free list (con mutex già acquisito).
+ * @return 0 in caso di successo, -1 se la memoria è insufficiente.
+ */
+static int pool_grow(pool_class_t* c) {
+    char* slab = malloc(EMERGENCY_SLAB_SIZE * c->item_size);
+    CHECK_MALLOC(slab, fail);
+    for (int i = EMERGENCY_SLAB_SIZE - 1; i >= 0; i--) {
+        emergency_t* e = (emergency_t*)(slab + i * c->item_size);
+        *free_link(e) = c->free_list;
+        c->free_list = e;
+    }
+    c->slab_count++;
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Allocato blocco di %d emergenze %s (%zu byte ciascuna, blocchi: %d)",
+        EMERGENCY_SLAB_SIZE, c->type->emergency_desc, c->item_size, c->slab_count);
+    log_event("0300", "MEMORY", log_msg);
+    return 0;
+    fail:
+    return -1;
+}
+
+emergency_t* emergency_pool_get(const emergency_type_t* type) {
+    if (type->id < 0 || type->id >= class_count) return NULL;
+    pool_class_t* c = &classes[type->id];
+    mtx_lock(&pool_mutex);
+    if (!c->free_list && pool_grow(c) != 0) {
+        mtx_unlock(&pool_mutex);
+        return NULL;
+    }
+    emergency_t* e = c->free_list;
+    c->free_list = *free_link(e);
+    mtx_unlock(&pool_mutex);
+
+    // Azzera lo stato lasciato dall'uso precedente
+    memset(e, 0, c->item_size);
+    e->type = type;
+    e->priority = type->priority;
+    e->status = WAITING;
+    e->rescuer_count = type->rescuers_total;
+    e->queue_index = -1;
+    return e;
+}
+
+void emergency_pool_put(emergency_t* e) {
+    pool_class_t* c = &classes[e->type->id];
+    mtx_lock(&pool_mutex);
+    *free_link(e) = c->free_list;
+    c->free_list = e;
+    mtx_unlock(&pool_mutex);
+}
@@ -4,16 +4,41 @@
 #include "logger.h"
 #include "macros.h"
 #include <stdlib.h>
+#include <limits.h>
+#include <time.h>
 #include <threads.h>
 
-// Numero massimo di emergenze che la coda può contenere
-#define MAX_EMERGENCIES 100
+// Numero di slot di ciascun segmento (chunk) dell'heap: deve essere una potenza di 2
+#define CHUNK_SHIFT 8
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
 
-// Coda circolare di emergenze
-static emergency_t* emergency_queue[MAX_EMERGENCIES];  // array circolare per le emergenze
+// Accesso allo slot i-esimo dell'heap segmentato
+#define SLOT(i) (chunks[(i) >> CHUNK_SHIFT][(i) & CHUNK_MASK])
 
-// Indici per la testa (head), la coda (tail) e il conteggio degli elementi (count)
-static int head = 0, tail = 0, count = 0;             // indici e conteggio
+// Heap binario di emergenze: in cima c'è sempre l'emergenza con priorità più alta
+// (a parità di priorità quella arrivata per prima).
+// Lo spazio è diviso in segmenti di CHUNK_SIZE slot allocati su richiesta,
+// così la coda cresce senza riallocare né copiare gli elementi già presenti.
+static emergency_t*** chunks = NULL;   // Directory dei segmenti in uso
+static int chunk_count = 0;            // Segmenti attualmente in uso
+static int chunk_dir_size = 0;         // Capacità della directory dei segmenti
+
+// Pool dei segmenti liberati, riutilizzati alla crescita successiva invece di richiamare malloc
+static emergency_t** chunk_pool[64];
+static int chunk_pool_count = 0;
+
+// Numero di elementi presenti nell'heap
+static int count = 0;
+
+// Limiti configurabili (0 = nessun limite): oltre il soft si segnala congestione,
+// al raggiungimento dell'hard il ricevitore smette di leggere dalla message queue
+static int soft_limit = 0;
+static int hard_limit = 0;
+static int over_soft_limit = 0;        // 1 se la coda ha superato il soft limit (per loggare una sola volta)
+
+// Contatore delle sequenze di arrivo, usato per mantenere l'ordine FIFO a parità di priorità
+static unsigned long next_seq = 0;
 
 // Mutex per la mutua esclusione nell'accesso alla coda
 static mtx_t queue_mutex;
@@ -21,16 +46,151 @@ static mtx_t queue_mutex;
 // Variabile di condizione per notificare la presenza di nuove emergenze
 static cnd_t queue_not_empty;
 
+// Variabile di condizione per notificare che la coda è scesa sotto l'hard limit
+static cnd_t queue_not_full;
+
 /**
  * @brief Inizializza la coda delle emergenze, mutex e variabili di condizione.
  * 
  * Va chiamata una sola volta prima di utilizzare le funzioni add/get.
- * Inizializza mutex e variabile di condizione, e azzera gli indici della coda.
+ * Inizializza mutex e variabili di condizione, e azzera gli indici della coda.
+ * 
+ * @param soft Soglia oltre la quale viene segnalata la congestione (0 = disattivata).
+ * @param hard Numero massimo di emergenze in coda (0 = coda illimitata).
  */
-void emergency_queue_init() {
+void emergency_queue_init(int soft, int hard) {
     mtx_init(&queue_mutex, mtx_plain);      // Inizializza il mutex
     cnd_init(&queue_not_empty);   // Inizializza la variabile di condizione
-    head = tail = count = 0;                     // Reset degli indici e del conteggio
+    cnd_init(&queue_not_full);    // Inizializza la variabile di condizione per la backpressure
+    count = 0;                    // Reset del conteggio
+    next_seq = 0;                 // Reset delle sequenze di arrivo
+    soft_limit = soft > 0 ? soft : 0;
+    hard_limit = hard > 0 ? hard : 0;
+    over_soft_limit = 0;
+}
+
+/**
+ * @brief Garantisce che esista uno slot per l'elemento di indice count (con mutex già acquisito).
+ * 
+ * Se serve un nuovo segmento lo preleva dal pool oppure lo alloca.
+ * 
+ * @return 0 se lo slot è disponibile, -1 in caso di memoria insufficiente.
+ */
+static int heap_reserve_slot() {
+    if ((count >> CHUNK_SHIFT) < chunk_count) return 0; // Lo slot esiste già
+
+    // Allarga la directory dei segmenti se necessario
+    if (chunk_count == chunk_dir_size) {
+        int new_size = chunk_dir_size ? chunk_dir_size * 2 : 4;
+        emergency_t*** temp = realloc(chunks, new_size * sizeof(emergency_t**));
+        CHECK_MALLOC(temp, fail);
+        chunks = temp;
+        chunk_dir_size = new_size;
+    }
+
+    // Preferisce un segmento già allocato in precedenza
+    emergency_t** chunk = NULL;
+    if (chunk_pool_count > 0) {
+        chunk = chunk_pool[--chunk_pool_count];
+    } else {
+        chunk = malloc(CHUNK_SIZE * sizeof(emergency_t*));
+        CHECK_MALLOC(chunk, fail);
+    }
+    chunks[chunk_count++] = chunk;
+    return 0;
+    fail:
+    return -1;
+}
+
+/**
+ * @brief Restituisce al pool i segmenti rimasti vuoti (con mutex già acquisito).
+ * 
+ * Viene mantenuto sempre un segmento vuoto di scorta per evitare di liberare e
+ * riprendere lo stesso segmento quando la coda oscilla attorno a un confine.
+ */
+static void heap_release_chunks() {
+    int needed = (count >> CHUNK_SHIFT) + 1;
+    while (chunk_count > needed + 1) {
+        emergency_t** chunk = chunks[--chunk_count];
+        if (chunk_pool_count < (int)(sizeof(chunk_pool) / sizeof(chunk_pool[0])))
+            chunk_pool[chunk_pool_count++] = chunk;
+        else
+            free(chunk);
+    }
+}
+
+/**
+ * @brief Confronta due emergenze secondo l'ordinamento dell'heap.
+ * @return 1 se a deve stare sopra b (priorità maggiore o, a parità, arrivata prima), 0 altrimenti.
+ */
+static int heap_before(const emergency_t* a, const emergency_t* b) {
+    if (a->priority != b->priority)
+        return a->priority > b->priority;
+    return a->queue_seq < b->queue_seq;
+}
+
+/**
+ * @brief Scrive un'emergenza in uno slot dell'heap aggiornando l'indice id→slot.
+ */
+static void heap_place(int slot, emergency_t* e) {
+    SLOT(slot) = e;
+    e->queue_index = slot;
+}
+
+/**
+ * @brief Fa risalire l'elemento nello slot indicato finché l'heap non è ordinato.
+ */
+static void heap_sift_up(int slot) {
+    emergency_t* e = SLOT(slot);
+    while (slot > 0) {
+        int parent = (slot - 1) / 2;
+        if (!heap_before(e, SLOT(parent))) break;
+        heap_place(slot, SLOT(parent)); // Sposta il padre verso il basso
+        slot = parent;
+    }
+    heap_place(slot, e);
+}
+
+/**
+ * @brief Fa scendere l'elemento nello slot indicato finché l'heap non è ordinato.
+ */
+static void heap_sift_down(int slot) {
+    emergency_t* e = SLOT(slot);
+    while (1) {
+        int child = 2 * slot + 1;
+        if (child >= count) break;
+        // Sceglie il figlio "maggiore" tra i due
+        if (child + 1 < count && heap_before(SLOT(child + 1), SLOT(child)))
+            child++;
+        if (!heap_before(SLOT(child), e)) break;
+        heap_place(slot, SLOT(child)); // Sposta il figlio verso l'alto
+        slot = child;
+    }
+    heap_place(slot, e);
+}
+
+/**
+ * @brief Rimuove dall'heap l'elemento nello slot indicato (con mutex già acquisito).
+ */
+static void heap_remove_at(int slot) {
+    emergency_t* removed = SLOT(slot);
+    count--;
+    if (slot != count) {
+        // Sposta l'ultimo elemento nello slot liberato e ripristina l'ordinamento
+        emergency_t* moved = SLOT(count);
+        heap_place(slot, moved);
+        heap_sift_up(slot);
+        heap_sift_down(moved->queue_index);
+    }
+    removed->queue_index = -1;
+    heap_release_chunks();
+
+    // Aggiorna lo stato di congestione e sblocca il ricevitore se si è liberato spazio
+    if (over_soft_limit && count <= soft_limit) {
+        over_soft_limit = 0;
+        log_event("0110", "MESSAGE_QUEUE", "Coda rientrata sotto la soglia di congestione");
+    }
+    if (hard_limit > 0 && count < hard_limit) cnd_signal(&queue_not_full);
 }
 
 char* stato_e(emergency_status_t status) {
@@ -47,52 +207,145 @@ char* stato_e(emergency_status_t status) {
 }
 
 /**
- * @brief Aggiunge un'emergenza alla coda.
+ * @brief Inserisce un'emergenza nell'heap (con mutex già acquisito).
  * 
- * Se la coda è piena, l'emergenza viene scartata e viene stampato un messaggio di errore.
- * La funzione è thread-safe grazie all'uso del mutex.
- * Dopo aver aggiunto un elemento, segnala eventuali thread in attesa.
+ * Se è stato raggiunto l'hard limit (o manca memoria) l'emergenza NON viene
+ * presa in carico e il chiamante resta proprietario della memoria.
+ * L'inserimento nell'heap costa O(log n).
  * 
- * @param e L'emergenza da aggiungere alla coda.
+ * @param e L'emergenza da inserire.
+ * @param requeue 1 per un'emergenza già accettata che torna in coda: l'hard limit non si applica.
+ * @return 0 se l'emergenza è stata accodata, -1 se è stata rifiutata.
  */
-void emergency_queue_add(emergency_t* e) {
-    mtx_lock(&queue_mutex);    // Acquisisce il mutex per l'accesso esclusivo
-
-    // Controlla se la coda è piena
-    if (count == MAX_EMERGENCIES) {
-        fprintf(stderr, "[queue] Errore: coda piena, emergenza scartata!\n");
+static int heap_insert(emergency_t* e, int requeue) {
+    // Controlla se la coda è piena o se non è possibile farla crescere
+    if (!requeue && hard_limit > 0 && count >= hard_limit) {
+        fprintf(stderr, "[queue] Errore: coda piena, emergenza rifiutata!\n");
         char log_msg[256];
-        snprintf(log_msg, sizeof(log_msg), "Errore: coda piena, emergenza scartata!");
+        snprintf(log_msg, sizeof(log_msg), "Errore: coda piena, emergenza rifiutata!");
         char id [5];
         snprintf(id, sizeof(id), "1%03d", e->id);
-        log_event(id, "MESSAGE_QUEUE", log_msg); // Logga lo scarto dell'emergenza
-        mtx_unlock(&queue_mutex);  // Rilascia il mutex prima di uscire
-        return;
+        log_emergency_event(e->id, id, "MESSAGE_QUEUE", log_msg); // Logga il rifiuto dell'emergenza
+        return -1;
+    }
+    if (heap_reserve_slot() != 0) {
+        fprintf(stderr, "[queue] Errore: memoria insufficiente, emergenza rifiutata!\n");
+        char id [5];
+        snprintf(id, sizeof(id), "1%03d", e->id);
+        log_emergency_event(e->id, id, "MESSAGE_QUEUE", "Errore: memoria insufficiente per far crescere la coda, emergenza rifiutata!");
+        return -1;
     }
 
-    // Logga l'aggiunta dell'emergenza alla coda
-    char log_msg[256];
-    snprintf(log_msg, sizeof(log_msg), "[(%s) (%d,%d) (%s)] Emergenza correttamente aggiunta alla coda", e->type.emergency_desc, e->x, e->y, stato_e(e->status));
-    char id [5];
-    snprintf(id, sizeof(id), "0%03d", e->id);
-    log_event(id, "EMERGENCY_INIT", log_msg);
+    // Logga l'aggiunta dell'emergenza alla coda (non quando torna dalla lista d'attesa o da una sospensione)
+    if (e->status == WAITING && !e->waiting_since) {
+        log_record(&(log_record_t){ .kind = LOG_EMERGENCY_INIT, .entity_id = e->id,
+            .type_name = e->type->emergency_desc, .status = e->status, .x = e->x, .y = e->y });
+    }
 
-    // Inserisce l'emergenza in coda e aggiorna l'indice di tail
-    emergency_queue[tail] = e;
-    tail = (tail + 1) % MAX_EMERGENCIES; // Gestione circolare dell'indice
+    // Inserisce l'emergenza in fondo all'heap e la fa risalire
+    e->queue_seq = next_seq++;
+    heap_place(count, e);
     count++;                             // Incrementa il conteggio degli elementi
+    heap_sift_up(e->queue_index);
 
-    // Stampa lo stato attuale della coda per debug
-    printf("📥 [queue] Aggiunta emergenza: %s (%d,%d)\n", e->type.emergency_desc, e->x, e->y);
-    printf("📥 [queue] Coda attuale: %d emergenze\n", count);
-    for (int i = 0; i < count; i++) {
-        int index = (head + i) % MAX_EMERGENCIES;
-        printf("📥 [queue] [%d] %s (%d,%d) stato [%d] id[%d]\n", i, emergency_queue[index]->type.emergency_desc, emergency_queue[index]->x, emergency_queue[index]->y, emergency_queue[index]->status, emergency_queue[index]->id);
+    // Segnala (una sola volta) il superamento della soglia di congestione
+    if (soft_limit > 0 && count > soft_limit && !over_soft_limit) {
+        over_soft_limit = 1;
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg), "Coda congestionata: %d emergenze in attesa (soglia %d)", count, soft_limit);
+        log_event("1110", "MESSAGE_QUEUE", log_msg);
     }
+    return 0;
+}
+
+/**
+ * @brief Aggiunge un blocco di emergenze alla coda con una sola acquisizione del mutex.
+ * 
+ * Le emergenze vengono inserite nell'ordine dato; alla prima rifiutata (hard limit
+ * o memoria insufficiente) l'inserimento si interrompe e le emergenze da quella in
+ * poi restano a carico del chiamante. I thread in attesa vengono svegliati una volta
+ * sola per tutto il blocco.
+ * 
+ * @param ems Emergenze da aggiungere.
+ * @param n Numero di emergenze.
+ * @return Numero di emergenze accodate (sempre le prime dell'array).
+ */
+int emergency_queue_add_batch(emergency_t** ems, int n) {
+    mtx_lock(&queue_mutex);    // Acquisisce il mutex per l'accesso esclusivo
+
+    int added = 0;
+    while (added < n && heap_insert(ems[added], 0) == 0) added++;
 
-    // Segnala ai thread in attesa che la coda non è più vuota
-    cnd_signal(&queue_not_empty);
+    if (added > 0) {
+        // Stampa lo stato attuale della coda per debug
+        if (added == 1)
+            printf("📥 [queue] Aggiunta emergenza: %s (%d,%d)\n", ems[0]->type->emergency_desc, ems[0]->x, ems[0]->y);
+        else
+            printf("📥 [queue] Aggiunte %d emergenze\n", added);
+        printf("📥 [queue] Coda attuale: %d emergenze (prossima: %s id[%d])\n", count, SLOT(0)->type->emergency_desc, SLOT(0)->id);
+
+        // Segnala ai thread in attesa che la coda non è più vuota
+        if (added == 1) cnd_signal(&queue_not_empty);
+        else cnd_broadcast(&queue_not_empty);
+    }
     mtx_unlock(&queue_mutex);    // Rilascia il mutex
+    return added;
+}
+
+/**
+ * @brief Aggiunge un'emergenza alla coda.
+ * 
+ * La coda cresce allocando nuovi segmenti quando serve. Se è stato raggiunto
+ * l'hard limit (o manca memoria) l'emergenza NON viene presa in carico e il
+ * chiamante resta proprietario della memoria.
+ * La funzione è thread-safe grazie all'uso del mutex.
+ * 
+ * @param e L'emergenza da aggiungere alla coda.
+ * @return 0 se l'emergenza è stata accodata, -1 se è stata rifiutata.
+ */
+int emergency_queue_add(emergency_t* e) {
+    return emergency_queue_add_batch(&e, 1) == 1 ? 0 : -1;
+}
+
+/**
+ * @brief Rimette in coda un'emergenza già accettata (risvegliata dalla lista d'attesa o sospesa).
+ * 
+ * L'hard limit serve a frenare i nuovi arrivi, non a scartare lavoro già preso in carico:
+ * il reinserimento lo ignora e può portare la coda oltre il limite, nel qual caso il
+ * ricevitore attende più a lungo in emergency_queue_wait_space. Fallisce solo se manca
+ * la memoria per far crescere la coda.
+ * 
+ * @param e L'emergenza da rimettere in coda.
+ * @return 0 se l'emergenza è stata accodata, -1 se è stata rifiutata.
+ */
+int emergency_queue_requeue(emergency_t* e) {
+    mtx_lock(&queue_mutex);
+    int result = heap_insert(e, 1);
+    if (result == 0) {
+        printf("📥 [queue] Riaccodata emergenza: %s (%d,%d)\n", e->type->emergency_desc, e->x, e->y);
+        cnd_signal(&queue_not_empty);
+    }
+    mtx_unlock(&queue_mutex);
+    return result;
+}
+
+/**
+ * @brief Attende finché la coda non ha spazio per almeno un'emergenza.
+ * 
+ * Usata dal ricevitore prima di leggere nuovi messaggi: finché la coda è
+ * all'hard limit i messaggi restano nella message queue POSIX, che a sua volta
+ * blocca i client in mq_send (backpressure). Senza hard limit ritorna subito.
+ * 
+ * @return Numero di emergenze che possono ancora essere accodate (INT_MAX se la coda è illimitata).
+ */
+int emergency_queue_wait_space() {
+    mtx_lock(&queue_mutex);
+    while (hard_limit > 0 && count >= hard_limit) {
+        cnd_wait(&queue_not_full, &queue_mutex);
+    }
+    int space = hard_limit > 0 ? hard_limit - count : INT_MAX;
+    mtx_unlock(&queue_mutex);
+    return space;
 }
 
 /**
@@ -100,47 +353,110 @@ void emergency_queue_add(emergency_t* e) {
  * 
  * Se la coda è vuota, il thread si blocca fino a quando non viene aggiunta un'emergenza.
  * La funzione è thread-safe grazie all'uso del mutex e della variabile di condizione.
+ * L'estrazione della cima dell'heap costa O(log n).
  * 
  * @return Puntatore all'emergenza estratta dalla coda.
  */
 emergency_t* emergency_queue_get() {
-    emergency_t* e = NULL; // Alloca memoria per l'emergenza
+    mtx_lock(&queue_mutex);    // Acquisisce il mutex per l'accesso esclusivo
 
-    while (1){  // Ciclo infinito per attendere un'emergenza
-    
-        mtx_lock(&queue_mutex);    // Acquisisce il mutex per l'accesso esclusivo
+    // Attende finché la coda è vuota
+    while (count == 0) {
+        cnd_wait(&queue_not_empty, &queue_mutex); // Attende una segnalazione
+    }
+    printf("📥 [queue] numero di emergenze in coda: %d\n", count);
 
-        // Attende finché la coda è vuota
-        while (count == 0) {
-            cnd_wait(&queue_not_empty, &queue_mutex); // Attende una segnalazione
-        }
-        printf("📥 [queue] numero di emergenze in coda: %d\n", count);
-
-        // Cerca l'emergenza con priorità più alta e status WAITING
-        short max_priority = -1;
-        int max_index = -1;
-        for (int i = 0; i < count; i++){
-            int index = (head + i) % MAX_EMERGENCIES; // Calcola l'indice circolare
-            if(emergency_queue[index]->type.priority > max_priority && emergency_queue[index]->status == WAITING) {
-                max_priority = emergency_queue[index]->type.priority;
-                max_index = index;
-            }
+    // In cima all'heap c'è l'emergenza con priorità più alta
+    emergency_t* e = SLOT(0);
+    heap_remove_at(0);
+
+    mtx_unlock(&queue_mutex);  // Rilascia il mutex
+    return e;                  // Restituisce l'emergenza estratta
+}
+
+/**
+ * @brief Estrae dalla coda un blocco di emergenze, raccolte in una finestra di tempo.
+ * 
+ * Attende la prima emergenza come emergency_queue_get(), poi continua ad attendere
+ * altri arrivi per al più window_ms millisecondi (tempo reale) o finché la coda non
+ * contiene max emergenze. Le emergenze vengono estratte in ordine di priorità.
+ * 
+ * @param out Array in cui scrivere le emergenze estratte (almeno max elementi).
+ * @param max Numero massimo di emergenze da estrarre.
+ * @param window_ms Durata massima della finestra di raccolta in millisecondi.
+ * @return Numero di emergenze estratte (almeno 1).
+ */
+int emergency_queue_get_batch(emergency_t** out, int max, int window_ms) {
+    mtx_lock(&queue_mutex);
+    while (count == 0) {
+        cnd_wait(&queue_not_empty, &queue_mutex);
+    }
+
+    // Finestra di raccolta: ogni inserimento risveglia l'attesa, che termina alla scadenza
+    if (window_ms > 0 && count < max) {
+        struct timespec deadline;
+        timespec_get(&deadline, TIME_UTC);
+        deadline.tv_sec += window_ms / 1000;
+        deadline.tv_nsec += (long)(window_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
         }
-        if (max_index != -1) {
-            e = emergency_queue[max_index]; // Estrae l'emergenza con priorità più alta
-            // Rimuove l'emergenza dalla coda spostando gli elementi successivi
-            for (int i = max_index; i != tail; i = (i + 1) % MAX_EMERGENCIES) {
-                int next = (i + 1) % MAX_EMERGENCIES;
-                if (next != tail)
-                    emergency_queue[i] = emergency_queue[next];
-            }
-            tail = (tail - 1 + MAX_EMERGENCIES) % MAX_EMERGENCIES; // Gestione circolare dell'indice
-            count--; // Decrementa il conteggio degli elementi
-            mtx_unlock(&queue_mutex);  // Rilascia il mutex
-            return e;                            // Restituisce l'emergenza estratta
+        while (count < max) {
+            if (cnd_timedwait(&queue_not_empty, &queue_mutex, &deadline) == thrd_timedout) break;
         }
+    }
 
-        // Nessuna emergenza con status WAITING trovata → aspetta ancora
+    int n = 0;
+    while (n < max && count > 0) {
+        out[n++] = SLOT(0);
+        heap_remove_at(0);
+    }
+    printf("📥 [queue] Estratte %d emergenze (in coda: %d)\n", n, count);
+    mtx_unlock(&queue_mutex);
+    return n;
+}
+
+/**
+ * @brief Rimuove dalla coda un'emergenza specifica (es. annullata prima di essere gestita).
+ * 
+ * Grazie all'indice dello slot salvato nell'emergenza la rimozione costa O(log n).
+ * 
+ * @param e L'emergenza da rimuovere.
+ * @return 0 se l'emergenza era in coda ed è stata rimossa, -1 altrimenti.
+ */
+int emergency_queue_remove(emergency_t* e) {
+    mtx_lock(&queue_mutex);
+    int slot = e->queue_index;
+    if (slot < 0 || slot >= count || SLOT(slot) != e) {
+        mtx_unlock(&queue_mutex);
+        return -1; // L'emergenza non è in coda
+    }
+    heap_remove_at(slot);
+    mtx_unlock(&queue_mutex);
+    return 0;
+}
+
+/**
+ * @brief Cambia la priorità di un'emergenza già in coda e ne aggiorna la posizione.
+ * 
+ * L'emergenza mantiene il proprio numero di sequenza, quindi a parità di priorità
+ * conserva l'ordine di arrivo originale. Costo O(log n).
+ * 
+ * @param e L'emergenza da ri-prioritizzare.
+ * @param priority Nuova priorità.
+ * @return 0 se l'emergenza era in coda ed è stata aggiornata, -1 altrimenti.
+ */
+int emergency_queue_update_priority(emergency_t* e, short priority) {
+    mtx_lock(&queue_mutex);
+    int slot = e->queue_index;
+    if (slot < 0 || slot >= count || SLOT(slot) != e) {
         mtx_unlock(&queue_mutex);
+        return -1; // L'emergenza non è in coda
     }
+    e->priority = priority;
+    heap_sift_up(slot);
+    heap_sift_down(e->queue_index);
+    mtx_unlock(&queue_mutex);
+    return 0;
 }
@@ -1,9 +1,51 @@
 #include "types.h"
 #include "logger.h"
+#include "emergency_pool.h"
 #include <threads.h>
 #include <stdlib.h>
+#include <limits.h>
 
-//Aggiungo un mutex alla struct di emergenza per gestire l' accesso concorrente senza dover bloccare tutti i soccorritori
+// Numero di lock a strisce che proteggono le emergenze (potenza di 2)
+#define EMERGENCY_LOCK_STRIPES 64
+
+// Le emergenze non hanno un mutex proprio: ciascuna usa il lock della striscia scelta dal suo ID.
+// Lock condivisi tra poche emergenze bastano, perché ogni sezione critica è brevissima
+static mtx_t emergency_locks[EMERGENCY_LOCK_STRIPES];
+static once_flag emergency_locks_once = ONCE_FLAG_INIT;
+
+static void init_emergency_locks(void) {
+    for (int i = 0; i < EMERGENCY_LOCK_STRIPES; i++) {
+        mtx_init(&emergency_locks[i], mtx_plain);
+    }
+}
+
+/**
+ * @brief Lock che protegge l'emergenza (stabile per tutta la sua vita, perché l'ID non cambia).
+ */
+static mtx_t* emergency_lock(const emergency_t* em) {
+    call_once(&emergency_locks_once, init_emergency_locks);
+    return &emergency_locks[(unsigned)em->id & (EMERGENCY_LOCK_STRIPES - 1)];
+}
+
+/**
+ * @brief Completa l'emergenza se nessun soccorritore è ancora sulla scena o in viaggio (mutex già acquisito).
+ * In caso di completamento rilascia il mutex e restituisce l'emergenza al pool.
+ * @return 1 se l'emergenza è stata completata e restituita al pool, 0 altrimenti (mutex ancora acquisito).
+ */
+static int complete_if_done(emergency_t* em) {
+    // Usa il contatore dei soccorritori ancora in viaggio o sulla scena: lo stato dei gemelli non basta,
+    // perché chi ha già terminato può essere stato riassegnato a un'altra emergenza
+    if (em->rescuers_busy > 0) {
+        return 0;
+    }
+    em->status = COMPLETED;
+    log_record(&(log_record_t){ .kind = LOG_EMERGENCY_STATUS, .entity_id = em->id, .status = COMPLETED });
+    mtx_unlock(emergency_lock(em));
+    emergency_pool_put(em); // Restituisce al pool l'emergenza completata
+    return 1;
+}
+
+//Ogni emergenza ha il proprio lock (a strisce) per gestire l' accesso concorrente senza dover bloccare tutti i soccorritori
 
 /**
  * @brief Aggiorna lo stato di una emergenza in modo thread-safe e gestisce la transizione di stato.
@@ -14,28 +56,28 @@
  * Questa funzione si occupa di:
  * - Aggiornare lo stato dell'emergenza solo se le condizioni sono soddisfatte.
  * - Loggare ogni transizione di stato.
- * - Liberare la memoria dell'emergenza se lo stato finale lo richiede.
+ * - Restituire l'emergenza al pool se lo stato finale lo richiede.
  * - Utilizzare un mutex per garantire la mutua esclusione sull'emergenza.
  */
 void update_emergency_status(emergency_t* em, emergency_status_t new_status) {
-    mtx_lock(&em->mutex); // Acquisisce il mutex per l'accesso esclusivo
+    mtx_lock(emergency_lock(em)); // Acquisisce il mutex per l'accesso esclusivo
     int status = 0; // Variabile di supporto per controlli di stato
-    char id[5];
+    // Evento di log della transizione (l'ID dell'emergenza viene letto prima che torni al pool)
+    log_record_t record = { .kind = LOG_EMERGENCY_STATUS, .entity_id = em->id, .status = new_status };
     switch (new_status)
     {
     case ASSIGNED:
         // Verifica che tutti i soccorritori siano assegnati (nessun NULL)
         status = 0;
         for (int i = 0; i < em->rescuer_count; i++) {
-            if (em->rescuers_dt[i] == NULL) {
+            if (em->slots[i].twin == NULL) {
                 status = 1;
                 break;
             }
         }
         if (!status) {
             em->status = new_status;
-            snprintf(id, sizeof(id), "0%03d", em->id);
-            log_event(id, "EMERGENCY_STATUS", "[ASSIGNED] Stato di emergenza aggiornato");
+            log_record(&record);
         }
         break;
     case IN_PROGRESS:
@@ -43,47 +85,102 @@ void update_emergency_status(emergency_t* em, emergency_status_t new_status) {
         status = (em->status == IN_PROGRESS);
         if (!status) {
             em->status = new_status;
-            snprintf(id, sizeof(id), "0%03d", em->id);
-            log_event(id, "EMERGENCY_STATUS", "[IN_PROGRESS] Stato di emergenza aggiornato");
+            log_record(&record);
         }
         break;
     case COMPLETED:
-        // Verifica che nessun soccorritore sia ancora sulla scena o in viaggio
-        status = 0;
-        for (int i = 0; i < em->rescuer_count; i++) {
-            if (em->rescuers_dt[i]->status == ON_SCENE || em->rescuers_dt[i]->status == EN_ROUTE_TO_SCENE) {
-                status = 1;
-                break;
-            }
-        }
-        if (!status) {
-            em->status = new_status;
-            snprintf(id, sizeof(id), "0%03d", em->id);
-            log_event(id, "EMERGENCY_STATUS", "[COMPLETED] Stato di emergenza aggiornato ");
-            free(em); // Libera la memoria dell'emergenza completata
-            return; // Esce dalla funzione dopo aver liberato la memoria
-        }
+        if (complete_if_done(em)) return; // Emergenza completata: già restituita al pool
         break;
     case TIMEOUT:
         // Gestione emergenza scaduta per timeout
         em->status = new_status;
-        snprintf(id, sizeof(id), "1%03d", em->id);
-        log_event(id, "EMERGENCY_STATUS", "[TIMEOUT] Stato di emergenza aggiornato");
-        free(em);
-        break;
+        record.error = 1;
+        log_record(&record);
+        mtx_unlock(emergency_lock(em));
+        emergency_pool_put(em);
+        return; // L'emergenza è tornata al pool
     case CANCELED:
         // Gestione emergenza annullata
         em->status = new_status;
-        snprintf(id, sizeof(id), "1%03d", em->id);
-        log_event(id, "EMERGENCY_STATUS", "[CANCELED] Stato di emergenza aggiornato");
-        free(em);
-        break;
+        record.error = 1;
+        log_record(&record);
+        mtx_unlock(emergency_lock(em));
+        emergency_pool_put(em);
+        return; // L'emergenza è tornata al pool
     default:
         // Gestione stato non valido
+        char id[5];
         snprintf(id, sizeof(id), "1%03d", em->id);
-        log_event(id, "EMERGENCY_STATUS", "Stato di emergenza non valido");
-        free(em);
-        break;
+        log_emergency_event(em->id, id, "EMERGENCY_STATUS", "Stato di emergenza non valido");
+        mtx_unlock(emergency_lock(em));
+        emergency_pool_put(em);
+        return; // L'emergenza è tornata al pool
+    }
+    mtx_unlock(emergency_lock(em)); // Rilascia il mutex
+}
+
+/**
+ * @brief Segnala che un soccorritore ha terminato il proprio intervento e rientra alla base.
+ *
+ * Il cambio di stato del soccorritore e la verifica degli altri soccorritori avvengono sotto
+ * lo stesso mutex dell'emergenza: se più soccorritori terminano nello stesso istante,
+ * solo l'ultimo vede l'emergenza conclusa e la completa (restituendola al pool).
+ *
+ * @param em Emergenza gestita dal soccorritore.
+ * @param r Soccorritore che ha terminato l'intervento.
+ */
+void release_emergency_rescuer(emergency_t* em, rescuer_digital_twin_t* r) {
+    mtx_lock(emergency_lock(em));
+    r->status = RETURNING_TO_BASE;
+    em->rescuers_busy--;
+    if (!complete_if_done(em)) mtx_unlock(emergency_lock(em));
+}
+
+/**
+ * @brief Verifica, senza modificarla, che un'emergenza in corso sia sospendibile richiamando recalled soccorritori.
+ *
+ * Usata per confermare tutti i richiami di una prelazione prima di sospendere qualunque vittima:
+ * con i soccorritori bloccati e i loro timer annullati l'esito non può cambiare fino a pause_emergency.
+ *
+ * @param em Emergenza da verificare.
+ * @param recalled Numero di soccorritori che verrebbero richiamati.
+ * @return 1 se è IN_PROGRESS e i soccorritori impegnati sono esattamente recalled, 0 altrimenti.
+ */
+int emergency_pausable(emergency_t* em, int recalled) {
+    mtx_lock(emergency_lock(em));
+    int pausable = em->status == IN_PROGRESS && em->rescuers_busy == recalled;
+    mtx_unlock(emergency_lock(em));
+    return pausable;
+}
+
+/**
+ * @brief Sospende un'emergenza in corso i cui soccorritori sono stati richiamati (prelazione).
+ *
+ * La sospensione riesce solo se l'emergenza è ancora IN_PROGRESS e i soccorritori richiamati
+ * sono esattamente quelli ancora impegnati: così nessuno può completarla mentre torna in coda.
+ * L'intervento svolto viene accreditato posto per posto: alla ripresa ogni posto della squadra
+ * deve completare solo il proprio residuo.
+ *
+ * @param em Emergenza da sospendere.
+ * @param recalled Numero di soccorritori richiamati (in viaggio o sulla scena).
+ * @param slots Posto nella squadra di ogni soccorritore richiamato.
+ * @param work_done Secondi di intervento svolti dall'ultima ripresa da ogni soccorritore richiamato.
+ * @return 0 se l'emergenza è passata in PAUSED, -1 altrimenti (nessuna modifica).
+ */
+int pause_emergency(emergency_t* em, int recalled, const int* slots, const int* work_done) {
+    mtx_lock(emergency_lock(em));
+    if (em->status != IN_PROGRESS || em->rescuers_busy != recalled) {
+        mtx_unlock(emergency_lock(em));
+        return -1;
+    }
+    em->status = PAUSED;
+    em->rescuers_busy = 0;
+    for (int j = 0; j < recalled; j++) {
+        if (slots[j] < 0 || slots[j] >= em->rescuer_count) continue;
+        emergency_slot_t* slot = &em->slots[slots[j]];
+        slot->work_done = slot->work_done + work_done[j] > USHRT_MAX ? USHRT_MAX : slot->work_done + work_done[j];
     }
-    mtx_unlock(&em->mutex); // Rilascia il mutex
-}
\ No newline at end of file
+    log_record(&(log_record_t){ .kind = LOG_EMERGENCY_STATUS, .entity_id = em->id, .status = PAUSED });
+    mtx_unlock(emergency_lock(em));
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include "eta.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <threads.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ETA_X86 1
+#endif
+
+/**
+ * @brief Implementazione dei calcoli di ETA per un insieme di istruzioni.
+ */
+typedef struct {
+    const char* name;               // Nome del kernel
+    void (*compute)(const int*, const int*, int, int, int, int, int*);
+    int (*top_k)(const int*, const int*, int, int, int, int, int, int*, int*);
+} eta_kernel_t;
+
+/**
+ * @brief Inserisce un candidato nei k migliori (ordinati per ETA crescente) se li migliora.
+ * A parità di ETA resta il candidato già presente, che ha indice minore.
+ */
+static void top_k_insert(int* out_idx, int* out_eta, int* filled, int k, int index, int eta) {
+    if (*filled == k && eta >= out_eta[k - 1]) return;
+    int pos = *filled < k ? (*filled)++ : k - 1;
+    while (pos > 0 && out_eta[pos - 1] > eta) {
+        out_idx[pos] = out_idx[pos - 1];
+        out_eta[pos] = out_eta[pos - 1];
+        pos--;
+    }
+    out_idx[pos] = index;
+    out_eta[pos] = eta;
+}
+
+static void compute_scalar(const int* xs, const int* ys, int n, int x, int y, int speed, int* out) {
+    for (int i = 0; i < n; i++) {
+        out[i] = ( abs(xs[i] - x) + abs(ys[i] - y) ) / speed;
+    }
+}
+
+static int top_k_scalar(const int* xs, const int* ys, int n, int x, int y, int speed, int k, int* out_idx, int* out_eta) {
+    int filled = 0;
+    if (k <= 0) return 0;
+    for (int i = 0; i < n; i++) {
+        top_k_insert(out_idx, out_eta, &filled, k, i, ( abs(xs[i] - x) + abs(ys[i] - y) ) / speed);
+    }
+    return filled;
+}
+
+#ifdef ETA_X86
+__attribute__((target("sse4.1")))
+static __m128i eta_sse4(const int* xs, const int* ys, __m128i vx, __m128i vy, __m128 vspeed) {
+    __m128i dx = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)xs), vx));
+    __m128i dy = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)ys), vy));
+    return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(_mm_add_epi32(dx, dy)), vspeed));
+}
+
+__attribute__((target("sse4.1")))
+static void compute_sse4(const int* xs, const int* ys, int n, int x, int y, int speed, int* out) {
+    __m128i vx = _mm_set1_epi32(x), vy = _mm_set1_epi32(y);
+    __m128 vspeed = _mm_set1_ps((float)speed);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i*)(out + i), eta_sse4(xs + i, ys + i, vx, vy, vspeed));
+    }
+    compute_scalar(xs + i, ys + i, n - i, x, y, speed, out + i);
+}
+
+__attribute__((target("sse4.1")))
+static int top_k_sse4(const int* xs, const int* ys, int n, int x, int y, int speed, int k, int* out_idx, int* out_eta) {
+    __m128i vx = _mm_set1_epi32(x), vy = _mm_set1_epi32(y);
+    __m128 vspeed = _mm_set1_ps((float)speed);
+    int filled = 0, lanes[4];
+    if (k <= 0) return 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i eta = eta_sse4(xs + i, ys + i, vx, vy, vspeed);
+        // Scarta in blocco i 4 candidati se nessuno batte il peggiore dei k migliori
+        int threshold = filled < k ? INT_MAX : out_eta[k - 1];
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(eta, _mm_set1_epi32(threshold))));
+        if (!mask) continue;
+        _mm_storeu_si128((__m128i*)lanes, eta);
+        for (int l = 0; l < 4; l++) {
+            if (mask & (1 << l)) top_k_insert(out_idx, out_eta, &filled, k, i + l, lanes[l]);
+        }
+    }
+    for (; i < n; i++) {
+        top_k_insert(out_idx, out_eta, &filled, k, i, ( abs(xs[i] - x) + abs(ys[i] - y) ) / speed);
+    }
+    return filled;
+}
+
+__attribute__((target("avx2")))
+static __m256i eta_avx2(const int* xs, const int* ys, __m256i vx, __m256i vy, __m256 vspeed) {
+    __m256i dx = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)xs), vx));
+    __m256i dy = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)ys), vy));
+    return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(dx, dy)), vspeed));
+}
+
+__attribute__((target("avx2")))
+static void compute_avx2(const int* xs, const int* ys, int n, int x, int y, int speed, int* out) {
+    __m256i vx = _mm256_set1_epi32(x), vy = _mm256_set1_epi32(y);
+    __m256 vspeed = _mm256_set1_ps((float)speed);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i*)(out + i), eta_avx2(xs + i, ys + i, vx, vy, vspeed));
+    }
+    compute_scalar(xs + i, ys + i, n - i, x, y, speed, out + i);
+}
+
+__attribute__((target("avx2")))
+static int top_k_avx2(const int* xs, const int* ys, int n, int x, int y, int speed, int k, int* out_idx, int* out_eta) {
+    __m256i vx = _mm256_set1_epi32(x), vy = _mm256_set1_epi32(y);
+    __m256 vspeed = _mm256_set1_ps((float)speed);
+    int filled = 0, lanes[8];
+    if (k <= 0) return 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i eta = eta_avx2(xs + i, ys + i, vx, vy, vspeed);
+        // Scarta in blocco gli 8 candidati se nessuno batte il peggiore dei k migliori
+        int threshold = filled < k ? INT_MAX : out_eta[k - 1];
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(threshold), eta)));
+        if (!mask) continue;
+        _mm256_storeu_si256((__m256i*)lanes, eta);
+        for (int l = 0; l < 8; l++) {
+            if (mask & (1 << l)) top_k_insert(out_idx, out_eta, &filled, k, i + l, lanes[l]);
+        }
+    }
+    for (; i < n; i++) {
+        top_k_insert(out_idx, out_eta, &filled, k, i, ( abs(xs[i] - x) + abs(ys[i] - y) ) / speed);
+    }
+    return filled;
+}
+#endif
+
+// Kernel disponibili, dal più generico al più veloce
+static const eta_kernel_t kernels[] = {
+    { "scalar", compute_scalar, top_k_scalar },
+#ifdef ETA_X86
+    { "sse4.1", compute_sse4, top_k_sse4 },
+    { "avx2", compute_avx2, top_k_avx2 },
+#endif
+};
+
+static const eta_kernel_t* active = &kernels[0];
+static once_flag eta_once = ONCE_FLAG_INIT;
+
+/**
+ * @brief Verifica se la CPU supporta un kernel.
+ */
+static int kernel_supported(const eta_kernel_t* kernel) {
+#ifdef ETA_X86
+    __builtin_cpu_init();
+    if (strcmp(kernel->name, "avx2") == 0) return __builtin_cpu_supports("avx2");
+    if (strcmp(kernel->name, "sse4.1") == 0) return __builtin_cpu_supports("sse4.1");
+#endif
+    return strcmp(kernel->name, "scalar") == 0;
+}
+
+/**
+ * @brief Sceglie il kernel più veloce supportato dalla CPU (eseguita una sola volta).
+ */
+static void select_kernel(void) {
+    for (int i = (int)(sizeof(kernels) / sizeof(kernels[0])) - 1; i >= 0; i--) {
+        if (kernel_supported(&kernels[i])) {
+            active = &kernels[i];
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Calcola l'ETA di tutti i candidati verso un punto.
+ */
+void eta_compute(const int* xs, const int* ys, int n, int x, int y, int speed, int* out) {
+    call_once(&eta_once, select_kernel);
+    active->compute(xs, ys, n, x, y, speed, out);
+}
+
+/**
+ * @brief Trova, in una sola passata, i k candidati con ETA minore verso un punto.
+ */
+int eta_top_k(const int* xs, const int* ys, int n, int x, int y, int speed, int k, int* out_idx, int* out_eta) {
+    call_once(&eta_once, select_kernel);
+    return active->top_k(xs, ys, n, x, y, speed, k, out_idx, out_eta);
+}
+
+/**
+ * @brief Nome del kernel in uso.
+ */
+const char* eta_kernel_name(void) {
+    call_once(&eta_once, select_kernel);
+    return active->name;
+}
+
+/**
+ * @brief Forza un kernel (usato dal benchmark per confrontarli).
+ */
+int eta_use_kernel(const char* name) {
+    call_once(&eta_once, select_kernel);
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (strcmp(kernels[i].name, name) == 0 && kernel_supported(&kernels[i])) {
+            active = &kernels[i];
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,96 @@
+// eta_bench.c - Microbenchmark dei kernel ETA (scalare, SSE4.1, AVX2) su flotte da 1k a 1M soccorritori
+// Uso: ./build/eta_bench [k]   (k = candidati restituiti dal top-k, default 16)
+
+#include "eta.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Elementi elaborati per ogni misura (le ripetizioni si adattano alla dimensione della flotta)
+#define BENCH_WORK 50000000L
+
+/**
+ * @brief Istante corrente in nanosecondi (orologio monotono).
+ */
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+    int k = argc > 1 ? atoi(argv[1]) : 16;
+    if (k <= 0) k = 16;
+    const char* names[] = { "scalar", "sse4.1", "avx2" };
+    const int sizes[] = { 1000, 10000, 100000, 1000000 };
+    int max_n = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+
+    int* xs = malloc(max_n * sizeof(int));
+    int* ys = malloc(max_n * sizeof(int));
+    int* out = malloc(max_n * sizeof(int));
+    int* expected = malloc(max_n * sizeof(int));
+    int* idx = malloc(k * sizeof(int));
+    int* eta = malloc(k * sizeof(int));
+    int* expected_idx = malloc(k * sizeof(int));
+    if (!xs || !ys || !out || !expected || !idx || !eta || !expected_idx) {
+        fprintf(stderr, "Memoria insufficiente\n");
+        return 1;
+    }
+    srand(42);
+    for (int i = 0; i < max_n; i++) {
+        xs[i] = rand() % 4096;
+        ys[i] = rand() % 4096;
+    }
+    int x = 2048, y = 1024, speed = 3;
+
+    printf("Kernel selezionato all'avvio: %s (top-k con k = %d)\n\n", eta_kernel_name(), k);
+    printf("%-8s %10s %14s %8s %14s %8s\n", "kernel", "flotta", "ETA (ns/el)", "speedup", "top-k (ns/el)", "speedup");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int n = sizes[s];
+        long reps = BENCH_WORK / n;
+        double scalar_compute_ns = 0, scalar_top_k_ns = 0;
+        for (size_t v = 0; v < sizeof(names) / sizeof(names[0]); v++) {
+            if (eta_use_kernel(names[v]) != 0) {
+                printf("%-8s %10d %14s %8s %14s %8s\n", names[v], n, "n/d", "-", "n/d", "-");
+                continue;
+            }
+            // Il kernel scalare è il riferimento: gli altri devono dare gli stessi risultati
+            eta_compute(xs, ys, n, x, y, speed, out);
+            int found = eta_top_k(xs, ys, n, x, y, speed, k, idx, eta);
+            if (v == 0) {
+                memcpy(expected, out, n * sizeof(int));
+                memcpy(expected_idx, idx, found * sizeof(int));
+            } else if (memcmp(expected, out, n * sizeof(int)) != 0 || memcmp(expected_idx, idx, found * sizeof(int)) != 0) {
+                fprintf(stderr, "Risultati diversi dal kernel scalare: %s (flotta %d)\n", names[v], n);
+                return 1;
+            }
+
+            double start = now_ns();
+            for (long r = 0; r < reps; r++) {
+                eta_compute(xs, ys, n, x + (int)(r & 7), y, speed, out);
+            }
+            double compute_ns = (now_ns() - start) / ((double)reps * n);
+            start = now_ns();
+            for (long r = 0; r < reps; r++) {
+                eta_top_k(xs, ys, n, x + (int)(r & 7), y, speed, k, idx, eta);
+            }
+            double top_k_ns = (now_ns() - start) / ((double)reps * n);
+            if (v == 0) {
+                scalar_compute_ns = compute_ns;
+                scalar_top_k_ns = top_k_ns;
+            }
+            printf("%-8s %10d %14.3f %7.2fx %14.3f %7.2fx\n", names[v], n,
+                   compute_ns, scalar_compute_ns / compute_ns, top_k_ns, scalar_top_k_ns / top_k_ns);
+        }
+    }
+
+    free(xs);
+    free(ys);
+    free(out);
+    free(expected);
+    free(idx);
+    free(eta);
+    free(expected_idx);
+    return 0;
+}
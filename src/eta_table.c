@@ -0,0 +1,233 @@
+#include "eta_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <threads.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "logger.h"
+#include "macros.h"
+
+#define ETA_TABLE_MAGIC 0x45544154u     // "ETAT"
+#define ETA_TABLE_VERSION 1
+#define ETA_COST_MANHATTAN 0            // Distanza di Manhattan / velocità
+
+/**
+ * @brief Intestazione del file di cache: la tabella vale solo per la stessa mappa, base, velocità e modello di costo.
+ */
+typedef struct {
+    unsigned int magic;             // ETA_TABLE_MAGIC
+    int version;                    // ETA_TABLE_VERSION
+    int width;                      // Larghezza della mappa
+    int height;                     // Altezza della mappa
+    int base_x;                     // Coordinata X della base del tipo
+    int base_y;                     // Coordinata Y della base del tipo
+    int speed;                      // Velocità del tipo
+    int cost_model;                 // Modello di costo (ETA_COST_MANHATTAN)
+} eta_table_header_t;
+
+/**
+ * @brief Tabella di un tipo di soccorritore.
+ */
+typedef struct {
+    const rescuer_type_t* type;     // Tipo di soccorritore
+    const unsigned short* cells;    // Tempi di viaggio, (width + 1) * (height + 1) celle per righe (NULL se assente)
+    int from_cache;                 // 1 se la tabella è stata letta da una cache valida
+} eta_table_t;
+
+static eta_table_t* tables = NULL;
+static int table_count = 0;
+static int map_width = 0;
+static int map_height = 0;
+static const char* cache_dir = ".";
+
+/**
+ * @brief Intestazione attesa per la tabella di un tipo.
+ */
+static eta_table_header_t expected_header(const rescuer_type_t* type) {
+    return (eta_table_header_t){ .magic = ETA_TABLE_MAGIC, .version = ETA_TABLE_VERSION,
+        .width = map_width, .height = map_height, .base_x = type->x, .base_y = type->y,
+        .speed = type->speed, .cost_model = ETA_COST_MANHATTAN };
+}
+
+/**
+ * @brief Tempo di viaggio massimo dalla base del tipo, verso l'angolo della mappa più lontano.
+ */
+static long max_travel_time(const rescuer_type_t* type) {
+    int speed = type->speed > 0 ? type->speed : 1;
+    long dx = abs(type->x) > abs(map_width - type->x) ? abs(type->x) : abs(map_width - type->x);
+    long dy = abs(type->y) > abs(map_height - type->y) ? abs(type->y) : abs(map_height - type->y);
+    return (dx + dy) / speed;
+}
+
+/**
+ * @brief Calcola i tempi di viaggio dalla base del tipo a ogni punto della mappa.
+ */
+static void fill_cells(const rescuer_type_t* type, unsigned short* cells) {
+    int speed = type->speed > 0 ? type->speed : 1;
+    for (int y = 0; y <= map_height; y++) {
+        unsigned short* row = &cells[(size_t)y * (map_width + 1)];
+        int dy = abs(y - type->y);
+        for (int x = 0; x <= map_width; x++) {
+            row[x] = (unsigned short)(( abs(x - type->x) + dy ) / speed);
+        }
+    }
+}
+
+/**
+ * @brief Mappa in sola lettura il file di cache se l'intestazione corrisponde.
+ * @return 0 se la tabella è stata mappata, -1 altrimenti.
+ */
+static int map_cache(eta_table_t* t, const char* path, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // La mappatura resta valida anche dopo la chiusura
+    if (map == MAP_FAILED) return -1;
+    eta_table_header_t expected = expected_header(t->type);
+    if (memcmp(map, &expected, sizeof(expected)) != 0) {
+        munmap(map, size);
+        return -1;
+    }
+    t->cells = (const unsigned short*)((const char*)map + sizeof(eta_table_header_t));
+    return 0;
+}
+
+/**
+ * @brief Scrive il file di cache (su un file temporaneo rinominato alla fine, mai a metà).
+ * Il file temporaneo ha un nome univoco: più processi che costruiscono la stessa cache non si sovrascrivono.
+ * @return 0 se il file è stato scritto, -1 altrimenti.
+ */
+static int write_cache(const char* path, const eta_table_header_t* header, const unsigned short* cells, size_t cells_size) {
+    char tmp_path[512];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path) >= (int)sizeof(tmp_path)) return -1;
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) return -1;
+    int ok = fchmod(fd, 0644) == 0 // mkstemp crea il file con permessi 0600
+          && write(fd, header, sizeof(*header)) == (ssize_t)sizeof(*header)
+          && write(fd, cells, cells_size) == (ssize_t)cells_size;
+    close(fd);
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Thread di costruzione della tabella di un tipo: cache valida, oppure calcolo e nuova cache.
+ * @param arg Puntatore a eta_table_t.
+ */
+static int build_table(void* arg) {
+    eta_table_t* t = arg;
+    if (max_travel_time(t->type) > USHRT_MAX) return 0; // Tempi oltre i 16 bit delle celle: nessuna tabella
+    size_t cells_size = (size_t)(map_width + 1) * (map_height + 1) * sizeof(unsigned short);
+    size_t size = sizeof(eta_table_header_t) + cells_size;
+    char path[256];
+    snprintf(path, sizeof(path), "%s/eta_table_%d.bin", cache_dir, t->type->id);
+
+    if (map_cache(t, path, size) == 0) {
+        t->from_cache = 1;
+        return 0;
+    }
+
+    unsigned short* cells = malloc(cells_size);
+    CHECK_MALLOC(cells, fail);
+    fill_cells(t->type, cells);
+    eta_table_header_t header = expected_header(t->type);
+    if (write_cache(path, &header, cells, cells_size) == 0 && map_cache(t, path, size) == 0) {
+        free(cells); // D'ora in poi si usa la copia mappata, condivisa con gli altri processi
+        return 0;
+    }
+    t->cells = cells; // Cache non scrivibile: la tabella resta in memoria
+    return 0;
+    fail:
+    return -1;
+}
+
+/**
+ * @brief Costruisce (o carica dalla cache) le tabelle di tutti i tipi di soccorritore, in parallelo.
+ * @param types Array dei tipi di soccorritore caricati da file.
+ * @param type_count Numero di tipi di soccorritore.
+ * @param width Larghezza della mappa.
+ * @param height Altezza della mappa.
+ * @param dir Directory dei file di cache (creata se manca).
+ */
+void eta_table_init(rescuer_type_info_t* types, int type_count, int width, int height, const char* dir) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    map_width = width;
+    map_height = height;
+    cache_dir = dir;
+    if (mkdir(cache_dir, 0755) != 0 && errno != EEXIST) {
+        // Senza directory le tabelle restano solo in memoria
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg), "Directory della cache %s non creata: %s", cache_dir, strerror(errno));
+        log_event("1700", "ETA_TABLE", log_msg);
+    }
+    tables = calloc(type_count > 0 ? type_count : 1, sizeof(eta_table_t));
+    thrd_t* threads = malloc((type_count > 0 ? type_count : 1) * sizeof(thrd_t));
+    int* started = malloc((type_count > 0 ? type_count : 1) * sizeof(int));
+    CHECK_MALLOC(tables, fail);
+    CHECK_MALLOC(threads, fail);
+    CHECK_MALLOC(started, fail);
+
+    // Un thread per tipo: le tabelle sono indipendenti
+    for (int i = 0; i < type_count; i++) {
+        tables[i].type = &types[i].rescuer_type; // types[i].rescuer_type.id == i
+        started[i] = thrd_create(&threads[i], build_table, &tables[i]) == thrd_success;
+        if (!started[i]) build_table(&tables[i]); // Niente thread: costruisce qui
+    }
+    int cached = 0;
+    for (int i = 0; i < type_count; i++) {
+        if (started[i]) thrd_join(threads[i], NULL);
+        cached += tables[i].from_cache;
+        if (!tables[i].cells) {
+            char log_msg[256];
+            snprintf(log_msg, sizeof(log_msg), "Tabella ETA non disponibile per il tipo %s: tempi calcolati a ogni richiesta",
+                     types[i].rescuer_type.rescuer_type_name);
+            log_event("1700", "ETA_TABLE", log_msg);
+        }
+    }
+    table_count = type_count;
+    free(threads);
+    free(started);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("🗺️ [ETA_TABLE] Tabelle ETA pronte per %d tipi (%d dalla cache) in %.1f ms\n", type_count, cached, elapsed_ms);
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Tabelle ETA pronte per %d tipi su mappa %dx%d (%d dalla cache) in %.1f ms",
+             type_count, width, height, cached, elapsed_ms);
+    log_event("0700", "ETA_TABLE", log_msg);
+    return;
+    fail:
+    free(tables);
+    free(threads);
+    free(started);
+    tables = NULL;
+    table_count = 0;
+}
+
+/**
+ * @brief Tempo di viaggio dalla base di un tipo di soccorritore a un punto della mappa.
+ * @param type_id ID del tipo di soccorritore.
+ * @param x Coordinata X del punto.
+ * @param y Coordinata Y del punto.
+ * @return Tempo di viaggio in secondi, -1 se il punto è fuori mappa o il tipo non ha una tabella.
+ */
+int eta_table_lookup(int type_id, int x, int y) {
+    if (type_id < 0 || type_id >= table_count || !tables[type_id].cells) return -1;
+    if (x < 0 || y < 0 || x > map_width || y > map_height) return -1;
+    return tables[type_id].cells[(size_t)y * (map_width + 1) + x];
+}
@@ -0,0 +1,166 @@
+#include "fleet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "macros.h"
+
+// Array paralleli indicizzati per ID del gemello digitale
+static _Atomic unsigned int* positions = NULL;   // (x << 16) | y
+static _Atomic unsigned char* statuses = NULL;   // rescuer_status_t
+static _Atomic short* priorities = NULL;         // Priorità dell'emergenza assegnata (-1 = nessuna)
+static _Atomic int* emergency_ids = NULL;        // ID dell'emergenza assegnata (-1 = nessuna)
+static _Atomic short* slots = NULL;              // Posto nella squadra dell'emergenza assegnata (-1 = nessuno)
+static unsigned short* type_ids = NULL;          // ID del tipo di soccorritore (scritto una volta all'avvio)
+static int unit_count = 0;
+
+/**
+ * @brief Impacchetta una posizione in un solo intero (le coordinate della mappa stanno in 16 bit).
+ */
+static unsigned int pack(int x, int y) {
+    return ((unsigned int)(unsigned short)x << 16) | (unsigned short)y;
+}
+
+/**
+ * @brief Alloca gli array della flotta (soccorritori fermi, IDLE, senza emergenza).
+ * @param count Numero totale di soccorritori.
+ */
+void fleet_init(int count) {
+    positions = malloc((count > 0 ? count : 1) * sizeof(*positions));
+    statuses = malloc((count > 0 ? count : 1) * sizeof(*statuses));
+    priorities = malloc((count > 0 ? count : 1) * sizeof(*priorities));
+    emergency_ids = malloc((count > 0 ? count : 1) * sizeof(*emergency_ids));
+    slots = malloc((count > 0 ? count : 1) * sizeof(*slots));
+    type_ids = calloc(count > 0 ? count : 1, sizeof(*type_ids));
+    CHECK_MALLOC(positions, fail);
+    CHECK_MALLOC(statuses, fail);
+    CHECK_MALLOC(priorities, fail);
+    CHECK_MALLOC(emergency_ids, fail);
+    CHECK_MALLOC(slots, fail);
+    CHECK_MALLOC(type_ids, fail);
+    for (int i = 0; i < count; i++) {
+        atomic_init(&positions[i], 0);
+        atomic_init(&statuses[i], IDLE);
+        atomic_init(&priorities[i], -1);
+        atomic_init(&emergency_ids[i], -1);
+        atomic_init(&slots[i], -1);
+    }
+    unit_count = count;
+    return;
+    fail:
+    unit_count = 0;
+}
+
+/**
+ * @brief Registra il tipo di un soccorritore (all'avvio, prima che la flotta sia condivisa).
+ * @param id ID del gemello digitale.
+ * @param type_id ID del tipo di soccorritore.
+ */
+void fleet_set_type(int id, int type_id) {
+    if (id < 0 || id >= unit_count) return;
+    type_ids[id] = (unsigned short)type_id;
+}
+
+/**
+ * @brief Tipo di un soccorritore.
+ * @param id ID del gemello digitale.
+ * @return ID del tipo di soccorritore (-1 se il soccorritore non esiste).
+ */
+int fleet_type(int id) {
+    if (id < 0 || id >= unit_count) return -1;
+    return type_ids[id];
+}
+
+/**
+ * @brief Pubblica stato ed emergenza assegnata di un soccorritore.
+ * @param id ID del gemello digitale.
+ * @param status Nuovo stato.
+ * @param em Emergenza assegnata (NULL se nessuna).
+ * @param slot Posto del soccorritore nella squadra di em (ignorato se em è NULL).
+ */
+void fleet_set_state(int id, rescuer_status_t status, const emergency_t* em, int slot) {
+    if (id < 0 || id >= unit_count) return;
+    atomic_store_explicit(&priorities[id], em ? em->priority : -1, memory_order_relaxed);
+    atomic_store_explicit(&emergency_ids[id], em ? em->id : -1, memory_order_relaxed);
+    atomic_store_explicit(&slots[id], em ? slot : -1, memory_order_relaxed);
+    atomic_store_explicit(&statuses[id], (unsigned char)status, memory_order_release);
+}
+
+/**
+ * @brief Emergenza assegnata a un soccorritore e suo posto nella squadra. Non acquisisce lock.
+ * @param id ID del gemello digitale.
+ * @param em_id Restituisce l'ID dell'emergenza (-1 se nessuna).
+ * @param slot Restituisce il posto nella squadra (-1 se nessuno).
+ */
+void fleet_assignment(int id, int* em_id, int* slot) {
+    if (id < 0 || id >= unit_count) {
+        *em_id = *slot = -1;
+        return;
+    }
+    *em_id = atomic_load_explicit(&emergency_ids[id], memory_order_relaxed);
+    *slot = atomic_load_explicit(&slots[id], memory_order_relaxed);
+}
+
+/**
+ * @brief Pubblica la posizione di un soccorritore.
+ * @param id ID del gemello digitale.
+ * @param x Coordinata X.
+ * @param y Coordinata Y.
+ */
+void fleet_set_position(int id, int x, int y) {
+    if (id < 0 || id >= unit_count) return;
+    atomic_store_explicit(&positions[id], pack(x, y), memory_order_release);
+}
+
+/**
+ * @brief Posizione attuale di un soccorritore. Non acquisisce lock.
+ * @param id ID del gemello digitale.
+ * @param x Restituisce la coordinata X.
+ * @param y Restituisce la coordinata Y.
+ */
+void fleet_position(int id, int* x, int* y) {
+    if (id < 0 || id >= unit_count) {
+        *x = *y = 0;
+        return;
+    }
+    unsigned int p = atomic_load_explicit(&positions[id], memory_order_acquire);
+    *x = (int)(p >> 16);
+    *y = (int)(p & 0xFFFF);
+}
+
+/**
+ * @brief Trova i soccorritori dei tipi indicati impegnati (in viaggio o sulla scena) su emergenze meno urgenti.
+ * @param below_priority Priorità (esclusa) sotto cui l'emergenza assegnata deve stare.
+ * @param types ID dei tipi di soccorritore cercati.
+ * @param type_count Numero di tipi cercati.
+ * @param out Array in cui scrivere gli ID trovati (almeno unit_count elementi).
+ * @return Numero di soccorritori trovati.
+ */
+int fleet_scan_busy(int below_priority, const int* types, int type_count, int* out) {
+    int found = 0;
+    for (int id = 0; id < unit_count; id++) {
+        int wanted = 0;
+        for (int t = 0; t < type_count && !wanted; t++) wanted = type_ids[id] == types[t];
+        if (!wanted) continue;
+        unsigned char status = atomic_load_explicit(&statuses[id], memory_order_acquire);
+        if (status != EN_ROUTE_TO_SCENE && status != ON_SCENE) continue;
+        short priority = atomic_load_explicit(&priorities[id], memory_order_relaxed);
+        if (priority >= 0 && priority < below_priority) out[found++] = id;
+    }
+    return found;
+}
+
+/**
+ * @brief Trova i soccorritori impegnati (in viaggio o sulla scena) su un'emergenza, di qualunque tipo.
+ * @param em_id ID dell'emergenza.
+ * @param out Array in cui scrivere gli ID trovati (almeno unit_count elementi).
+ * @return Numero di soccorritori trovati.
+ */
+int fleet_scan_emergency(int em_id, int* out) {
+    int found = 0;
+    for (int id = 0; id < unit_count; id++) {
+        unsigned char status = atomic_load_explicit(&statuses[id], memory_order_acquire);
+        if (status != EN_ROUTE_TO_SCENE && status != ON_SCENE) continue;
+        if (atomic_load_explicit(&emergency_ids[id], memory_order_relaxed) == em_id) out[found++] = id;
+    }
+    return found;
+}
@@ -0,0 +1,434 @@
+#include "log_file.h"
+#include "log_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Dimensione del buffer di scrittura (allineato alla pagina): una write ogni LOG_BUFFER_SIZE byte al massimo
+#define LOG_BUFFER_SIZE (1024 * 1024)
+#define LOG_BUFFER_ALIGN 4096
+// Tempo massimo (ms) in cui una riga può restare nel buffer prima di essere scritta su disco
+#define LOG_FLUSH_INTERVAL_MS 1000
+// Rotazione del log attivo: per dimensione o per età del segmento (ridefinibili in compilazione con -D)
+#ifndef LOG_SEGMENT_MAX_BYTES
+#define LOG_SEGMENT_MAX_BYTES (64LL * 1024 * 1024)
+#endif
+#ifndef LOG_SEGMENT_MAX_AGE_MS
+#define LOG_SEGMENT_MAX_AGE_MS (24LL * 60 * 60 * 1000)
+#endif
+
+extern char** environ;
+
+static char log_path[256];          // Percorso del log attivo
+static int log_fd = -1;             // File descriptor del log attivo (O_APPEND)
+static char* log_buffer = NULL;     // Buffer di scrittura allineato
+static size_t log_buffered = 0;     // Byte presenti nel buffer
+static long long log_buffered_since = 0; // Istante (ms) in cui il buffer ha smesso di essere vuoto
+static long long segment_size = 0;  // Byte già scritti (o bufferizzati) nel segmento attivo
+static long long segment_opened = 0; // Istante (ms, orologio monotono) di creazione del segmento attivo
+static int next_segment = 1;        // Numero del prossimo segmento chiuso
+static int compressors = 0;         // Processi di compressione ancora da raccogliere
+
+// Indice del segmento attivo (<path>.idx): tutte le voci restano in memoria per ordinarle alla chiusura
+static char idx_path[300];              // Percorso dell'indice del segmento attivo
+static int idx_fd = -1;                 // File descriptor dell'indice del segmento attivo
+static uint32_t idx_first_run = 0;      // Prima esecuzione con righe nel segmento attivo
+static long long idx_created_ms = 0;    // Creazione del segmento attivo (ms dall'epoch), salvata nell'intestazione
+static uint32_t log_run = 1;            // Esecuzione corrente del backend (parte della chiave delle entità)
+static log_index_entry_t* idx_entries = NULL; // Voci dell'indice del segmento attivo, in ordine di scrittura
+static size_t idx_count = 0;            // Numero di voci
+static size_t idx_capacity = 0;         // Capacità dell'array delle voci
+static size_t idx_flushed = 0;          // Voci già scritte su disco
+
+/**
+ * @brief Istante corrente in millisecondi sull'orologio monotono.
+ */
+static long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Istante corrente in millisecondi dall'epoch (per l'età dei segmenti tra un'esecuzione e l'altra).
+ */
+static long long wall_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Cerca il numero più alto tra i segmenti già presenti (<path>.<n> o <path>.<n>.gz).
+ */
+static int last_segment_number() {
+    char dir[256] = ".";
+    const char* base = log_path;
+    const char* slash = strrchr(log_path, '/');
+    if (slash) {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - log_path), log_path);
+        base = slash + 1;
+    }
+    size_t base_len = strlen(base);
+    int last = 0;
+    DIR* d = opendir(dir);
+    if (!d) return 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        // Accetta solo <base>.<numero> con eventuale estensione .gz
+        if (strncmp(entry->d_name, base, base_len) != 0 || entry->d_name[base_len] != '.') continue;
+        char* end;
+        long n = strtol(entry->d_name + base_len + 1, &end, 10);
+        if (end == entry->d_name + base_len + 1 || (*end != '\0' && strcmp(end, ".gz") != 0)) continue;
+        if (n > last) last = (int)n;
+    }
+    closedir(d);
+    return last;
+}
+
+/**
+ * @brief Ultima esecuzione registrata nell'intestazione di un indice (0 se l'indice manca o non è valido).
+ */
+static uint32_t index_last_run(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    log_index_header_t header;
+    int valid = pread(fd, &header, sizeof(header), 0) == sizeof(header)
+        && memcmp(header.magic, LOG_INDEX_MAGIC, sizeof(header.magic)) == 0 && header.version == LOG_INDEX_VERSION;
+    close(fd);
+    return valid ? header.last_run : 0;
+}
+
+/**
+ * @brief Cerca l'ultima esecuzione registrata negli indici già presenti (<path>.idx e <path>.<n>.idx).
+ */
+static uint32_t last_run_number() {
+    char dir[256] = ".";
+    const char* base = log_path;
+    const char* slash = strrchr(log_path, '/');
+    if (slash) {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - log_path), log_path);
+        base = slash + 1;
+    }
+    size_t base_len = strlen(base);
+    uint32_t last = index_last_run(idx_path);
+    DIR* d = opendir(dir);
+    if (!d) return last;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        // Accetta solo <base>.<numero>.idx
+        if (strncmp(entry->d_name, base, base_len) != 0 || entry->d_name[base_len] != '.') continue;
+        char* end;
+        long n = strtol(entry->d_name + base_len + 1, &end, 10);
+        if (end == entry->d_name + base_len + 1 || n <= 0 || strcmp(end, ".idx") != 0) continue;
+        char path[600];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        uint32_t run = index_last_run(path);
+        if (run > last) last = run;
+    }
+    closedir(d);
+    return last;
+}
+
+/**
+ * @brief Scrive su disco tutto il contenuto del buffer.
+ */
+static void log_file_flush() {
+    size_t done = 0;
+    while (done < log_buffered) {
+        ssize_t w = write(log_fd, log_buffer + done, log_buffered - done);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            perror("❌ Errore nella scrittura del file di log");
+            break; // Il contenuto non scritto viene perso: il logger non deve bloccarsi
+        }
+        done += (size_t)w;
+    }
+    log_buffered = 0;
+
+    // Le voci dell'indice vengono scritte dopo le righe a cui puntano, in coda a quelle già su disco
+    if (idx_fd >= 0 && idx_flushed < idx_count) {
+        const char* data = (const char*)(idx_entries + idx_flushed);
+        size_t len = (idx_count - idx_flushed) * sizeof(log_index_entry_t);
+        off_t pos = (off_t)(sizeof(log_index_header_t) + idx_flushed * sizeof(log_index_entry_t));
+        while (len > 0) {
+            ssize_t w = pwrite(idx_fd, data, len, pos);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                perror("❌ Errore nella scrittura dell'indice del log");
+                break;
+            }
+            data += w;
+            pos += w;
+            len -= (size_t)w;
+        }
+        idx_flushed = idx_count;
+    }
+}
+
+/**
+ * @brief Raccoglie i processi di compressione terminati (senza attendere).
+ */
+static void reap_compressors() {
+    while (compressors > 0 && waitpid(-1, NULL, WNOHANG) > 0) compressors--;
+}
+
+/**
+ * @brief Apre l'indice del segmento attivo, ricaricando le voci già presenti (riavvio in append).
+ * Un indice assente o non valido viene ricreato vuoto: le righe già presenti restano non indicizzate.
+ * L'intestazione registra l'esecuzione corrente come ultima con righe nel segmento
+ * e conserva l'istante di creazione del segmento, se questo non è vuoto.
+ */
+static void open_active_index() {
+    idx_count = idx_flushed = 0;
+    idx_first_run = log_run;
+    idx_fd = open(idx_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (idx_fd < 0) {
+        perror("❌ Errore nell'apertura dell'indice del log");
+        return;
+    }
+    log_index_header_t header;
+    struct stat st;
+    int valid = fstat(idx_fd, &st) == 0 && st.st_size >= (off_t)sizeof(header)
+        && pread(idx_fd, &header, sizeof(header), 0) == sizeof(header)
+        && memcmp(header.magic, LOG_INDEX_MAGIC, sizeof(header.magic)) == 0
+        && header.version == LOG_INDEX_VERSION && !header.sorted;
+    if (valid) {
+        size_t n = (st.st_size - sizeof(header)) / sizeof(log_index_entry_t);
+        if (n > idx_capacity) {
+            log_index_entry_t* temp = realloc(idx_entries, n * sizeof(log_index_entry_t));
+            if (!temp) n = 0;
+            else {
+                idx_entries = temp;
+                idx_capacity = n;
+            }
+        }
+        ssize_t r = pread(idx_fd, idx_entries, n * sizeof(log_index_entry_t), sizeof(header));
+        idx_count = r > 0 ? (size_t)r / sizeof(log_index_entry_t) : 0;
+        // Scarta le voci che puntano oltre la fine del log (es. righe perse in un arresto anomalo)
+        while (idx_count > 0 && (long long)idx_entries[idx_count - 1].offset >= segment_size) idx_count--;
+        idx_flushed = idx_count;
+        if (header.first_run > 0) idx_first_run = header.first_run;
+        if (segment_size > 0 && header.created_ms > 0) idx_created_ms = header.created_ms;
+        if ((size_t)r == n * sizeof(log_index_entry_t) && idx_count == n) {
+            header.last_run = log_run;
+            header.created_ms = idx_created_ms;
+            if (pwrite(idx_fd, &header, sizeof(header), 0) != sizeof(header)) perror("❌ Errore nella scrittura dell'indice del log");
+            return;
+        }
+    }
+    // Ricrea l'indice con le sole voci valide (riscritte al prossimo flush)
+    if (ftruncate(idx_fd, 0) != 0) perror("❌ Errore nella ricreazione dell'indice del log");
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LOG_INDEX_MAGIC, sizeof(header.magic));
+    header.version = LOG_INDEX_VERSION;
+    header.sorted = 0;
+    header.first_run = idx_first_run;
+    header.last_run = log_run;
+    header.created_ms = idx_created_ms;
+    if (pwrite(idx_fd, &header, sizeof(header), 0) != sizeof(header)) perror("❌ Errore nella scrittura dell'indice del log");
+    idx_flushed = 0;
+}
+
+/**
+ * @brief Apre (o crea) il file di log attivo in append, insieme al suo indice.
+ * L'età di un segmento già esistente parte dalla sua creazione (registrata nell'indice, o in mancanza
+ * dall'ultima modifica del file), così anche un backend riavviato spesso lo ruota dopo LOG_SEGMENT_MAX_AGE_MS.
+ */
+static int open_active_segment() {
+    log_fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd < 0) return -1;
+    struct stat st;
+    segment_size = fstat(log_fd, &st) == 0 ? (long long)st.st_size : 0;
+    long long wall = wall_ms();
+    idx_created_ms = segment_size > 0 ? (long long)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000 : wall;
+    open_active_index();
+    long long age = wall - idx_created_ms;
+    if (age < 0) age = 0; // Orologio di sistema spostato all'indietro
+    segment_opened = now_ms() - age;
+    return 0;
+}
+
+/**
+ * @brief Ordina le voci per (entità, tempo, offset).
+ */
+static int compare_entries(const void* a, const void* b) {
+    const log_index_entry_t* x = a;
+    const log_index_entry_t* y = b;
+    if (x->entity != y->entity) return x->entity < y->entity ? -1 : 1;
+    if (x->timestamp_ms != y->timestamp_ms) return x->timestamp_ms < y->timestamp_ms ? -1 : 1;
+    if (x->offset != y->offset) return x->offset < y->offset ? -1 : 1;
+    return 0;
+}
+
+/**
+ * @brief Scrive l'indice ordinato di un segmento chiuso e rimuove quello del segmento attivo.
+ */
+static void close_index(const char* segment) {
+    close(idx_fd);
+    idx_fd = -1;
+    qsort(idx_entries, idx_count, sizeof(log_index_entry_t), compare_entries);
+
+    char path[320];
+    snprintf(path, sizeof(path), "%s.idx", segment);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("❌ Errore nella scrittura dell'indice del log");
+        return;
+    }
+    log_index_header_t header = {0};
+    memcpy(header.magic, LOG_INDEX_MAGIC, sizeof(header.magic));
+    header.version = LOG_INDEX_VERSION;
+    header.sorted = 1;
+    header.first_run = idx_first_run;
+    header.last_run = log_run;
+    header.created_ms = idx_created_ms;
+    size_t len = idx_count * sizeof(log_index_entry_t);
+    if (write(fd, &header, sizeof(header)) != sizeof(header)
+        || write(fd, idx_entries, len) != (ssize_t)len) {
+        perror("❌ Errore nella scrittura dell'indice del log");
+    }
+    close(fd);
+    unlink(idx_path);
+    idx_count = idx_flushed = 0;
+}
+
+/**
+ * @brief Chiude il segmento attivo, lo rinomina in <path>.<n> e ne avvia la compressione in background.
+ */
+static void rotate() {
+    log_file_flush();
+    close(log_fd);
+    log_fd = -1;
+
+    char segment[300];
+    snprintf(segment, sizeof(segment), "%s.%d", log_path, next_segment++);
+    if (rename(log_path, segment) == 0) {
+        close_index(segment);
+        // Compressione in un processo separato: il logger non attende la sua fine
+        pid_t pid;
+        char* argv[] = { "gzip", "-f", segment, NULL };
+        if (posix_spawnp(&pid, "gzip", NULL, NULL, argv, environ) == 0) compressors++;
+    } else {
+        perror("❌ Errore nella rotazione del file di log");
+        close(idx_fd);
+        idx_fd = -1;
+    }
+    if (open_active_segment() != 0) perror("❌ Errore nell'apertura del file di log");
+}
+
+/**
+ * @brief Apre il file di log in append, preparando il buffer di scrittura.
+ * @param path Percorso del file di log attivo.
+ * @return 0 in caso di successo, -1 se il file non può essere aperto.
+ */
+int log_file_open(const char* path) {
+    snprintf(log_path, sizeof(log_path), "%s", path);
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+    if (posix_memalign((void**)&log_buffer, LOG_BUFFER_ALIGN, LOG_BUFFER_SIZE) != 0) {
+        log_buffer = NULL;
+        return -1;
+    }
+    log_buffered = 0;
+    next_segment = last_segment_number() + 1;
+    // Nuova esecuzione: gli ID delle entità ripartono da 0, la chiave dell'indice li distingue dalle precedenti
+    log_run = last_run_number() % LOG_RUN_MAX + 1;
+    if (open_active_segment() != 0) {
+        free(log_buffer);
+        log_buffer = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Aggiunge una riga al buffer del file di log (formato printf).
+ * La riga viene formattata direttamente nel buffer; il buffer viene scritto su disco quando è pieno,
+ * e il segmento viene ruotato quando supera la dimensione massima.
+ */
+void log_file_printf(const char* fmt, ...) {
+    if (log_fd < 0) return;
+    if (LOG_BUFFER_SIZE - log_buffered < LOG_LINE_MAX) log_file_flush(); // Spazio garantito per una riga intera
+    if (log_buffered == 0) log_buffered_since = now_ms();
+
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(log_buffer + log_buffered, LOG_LINE_MAX, fmt, args);
+    va_end(args);
+    if (len < 0) return;
+    if (len >= LOG_LINE_MAX) { // Riga troncata: la chiude comunque con un a capo
+        len = LOG_LINE_MAX - 1;
+        log_buffer[log_buffered + len - 1] = '\n';
+    }
+    log_buffered += (size_t)len;
+    segment_size += len;
+
+    if (segment_size >= LOG_SEGMENT_MAX_BYTES) rotate();
+}
+
+/**
+ * @brief Indicizza la prossima riga scritta nel log sotto l'entità indicata, nell'esecuzione corrente.
+ * @param entity_class Classe dell'entità (LOG_ENTITY_EMERGENCY o LOG_ENTITY_RESCUER).
+ * @param entity_id ID dell'entità.
+ * @param timestamp_ms Istante dell'evento in millisecondi.
+ */
+void log_file_index(int entity_class, int entity_id, long long timestamp_ms) {
+    if (log_fd < 0 || idx_fd < 0) return;
+    if (idx_count == idx_capacity) {
+        size_t new_capacity = idx_capacity ? idx_capacity * 2 : 4096;
+        log_index_entry_t* temp = realloc(idx_entries, new_capacity * sizeof(log_index_entry_t));
+        if (!temp) return; // Senza memoria la riga resta solo non indicizzata
+        idx_entries = temp;
+        idx_capacity = new_capacity;
+    }
+    // La riga verrà scritta subito dopo i dati già presenti nel segmento
+    idx_entries[idx_count++] = (log_index_entry_t){ LOG_ENTITY_KEY(entity_class, log_run, entity_id), timestamp_ms, (uint64_t)segment_size };
+}
+
+/**
+ * @brief Applica le politiche temporali: flush dei dati in attesa da troppo tempo e rotazione per età.
+ */
+void log_file_tick() {
+    if (log_fd < 0) return;
+    long long now = now_ms();
+    if (log_buffered > 0 && now - log_buffered_since >= LOG_FLUSH_INTERVAL_MS) log_file_flush();
+    if (segment_size > 0 && now - segment_opened >= LOG_SEGMENT_MAX_AGE_MS) rotate();
+    reap_compressors();
+}
+
+/**
+ * @brief Tempo massimo (ms) prima della prossima scadenza del flush del buffer.
+ * @return -1 se il buffer è vuoto (la rotazione per età viene controllata alla prossima scrittura).
+ */
+int log_file_wait_ms() {
+    if (log_fd < 0 || log_buffered == 0) return -1;
+    long long wait = log_buffered_since + LOG_FLUSH_INTERVAL_MS - now_ms();
+    return wait < 0 ? 0 : (int)wait;
+}
+
+/**
+ * @brief Scrive su disco i dati rimasti nel buffer e chiude il file di log.
+ */
+void log_file_close() {
+    if (log_fd < 0) return;
+    log_file_flush();
+    close(log_fd);
+    log_fd = -1;
+    if (idx_fd >= 0) close(idx_fd);
+    idx_fd = -1;
+    free(log_buffer);
+    log_buffer = NULL;
+    free(idx_entries);
+    idx_entries = NULL;
+    idx_count = idx_capacity = idx_flushed = 0;
+    reap_compressors();
+}
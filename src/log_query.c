@@ -0,0 +1,327 @@
+// log_query.c - Estrae da system.log (e dai suoi segmenti ruotati) le righe di un'emergenza o di un soccorritore
+// Usa gli indici <segmento>.idx scritti dal logger invece di scorrere l'intero log
+
+#include "log_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+/**
+ * @brief Segmento di log da interrogare.
+ */
+typedef struct {
+    int number;             // Numero del segmento (0 = log attivo)
+    int compressed;         // 1 se il segmento è compresso (.gz)
+} segment_t;
+
+/**
+ * @brief Ordina i segmenti dal più vecchio al più recente (il log attivo è l'ultimo).
+ */
+static int compare_segments(const void* a, const void* b) {
+    int x = ((const segment_t*)a)->number, y = ((const segment_t*)b)->number;
+    if (x == 0) x = INT_MAX;
+    if (y == 0) y = INT_MAX;
+    if (x != y) return (x > y) - (x < y);
+    // Durante la compressione possono esistere sia <path>.<n> che <path>.<n>.gz: prima il non compresso
+    return ((const segment_t*)a)->compressed - ((const segment_t*)b)->compressed;
+}
+
+static int compare_offsets(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Elenca i segmenti del log: <path>.<n>, <path>.<n>.gz e il log attivo <path>.
+ * @return Numero di segmenti trovati (array allocato in *out).
+ */
+static int list_segments(const char* path, segment_t** out) {
+    char dir[256] = ".";
+    const char* base = path;
+    const char* slash = strrchr(path, '/');
+    if (slash) {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+        base = slash + 1;
+    }
+    size_t base_len = strlen(base);
+    int count = 0, capacity = 16;
+    segment_t* segments = malloc(capacity * sizeof(segment_t));
+    if (!segments) return 0;
+
+    DIR* d = opendir(dir);
+    if (!d) {
+        free(segments);
+        return 0;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (strncmp(entry->d_name, base, base_len) != 0) continue;
+        segment_t seg = {0, 0};
+        if (entry->d_name[base_len] != '\0') {
+            if (entry->d_name[base_len] != '.') continue;
+            char* end;
+            long n = strtol(entry->d_name + base_len + 1, &end, 10);
+            if (end == entry->d_name + base_len + 1 || n <= 0) continue;
+            if (strcmp(end, ".gz") == 0) seg.compressed = 1;
+            else if (*end != '\0') continue; // .idx o altri file
+            seg.number = (int)n;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            segment_t* temp = realloc(segments, capacity * sizeof(segment_t));
+            if (!temp) break;
+            segments = temp;
+        }
+        segments[count++] = seg;
+    }
+    closedir(d);
+    qsort(segments, count, sizeof(segment_t), compare_segments);
+    *out = segments;
+    return count;
+}
+
+/**
+ * @brief Costruisce i percorsi del file di log e dell'indice di un segmento.
+ */
+static void segment_paths(const char* log_path, const segment_t* segment, char* data_path, size_t data_size,
+                          char* idx_path, size_t idx_size) {
+    if (segment->number == 0) {
+        snprintf(data_path, data_size, "%s", log_path);
+        snprintf(idx_path, idx_size, "%s.idx", log_path);
+    } else {
+        snprintf(data_path, data_size, "%s.%d%s", log_path, segment->number, segment->compressed ? ".gz" : "");
+        snprintf(idx_path, idx_size, "%s.%d.idx", log_path, segment->number);
+    }
+}
+
+/**
+ * @brief Ultima esecuzione registrata nell'intestazione di un indice (0 se l'indice manca o non è valido).
+ */
+static uint32_t index_last_run(const char* idx_path) {
+    int fd = open(idx_path, O_RDONLY);
+    if (fd < 0) return 0;
+    log_index_header_t header;
+    int valid = pread(fd, &header, sizeof(header), 0) == sizeof(header)
+        && memcmp(header.magic, LOG_INDEX_MAGIC, sizeof(header.magic)) == 0 && header.version == LOG_INDEX_VERSION;
+    close(fd);
+    return valid ? header.last_run : 0;
+}
+
+/**
+ * @brief Cerca nell'indice di un segmento gli offset delle righe dell'entità nell'intervallo di tempo.
+ * Gli indici dei segmenti chiusi sono ordinati e vengono interrogati con una ricerca binaria,
+ * quello del log attivo (in ordine di scrittura) viene scorso per intero.
+ * I segmenti senza righe dell'esecuzione cercata vengono saltati senza scorrerne le voci.
+ * @return Numero di offset trovati (array allocato in *out, ordinato), -1 se l'indice manca.
+ */
+static long find_offsets(const char* idx_path, uint32_t run, uint64_t entity, int64_t from_ms, int64_t to_ms, uint64_t** out) {
+    int fd = open(idx_path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(log_index_header_t)) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const log_index_header_t* header = map;
+    if (memcmp(header->magic, LOG_INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != LOG_INDEX_VERSION) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+    const log_index_entry_t* entries = (const log_index_entry_t*)(header + 1);
+    size_t n = (st.st_size - sizeof(*header)) / sizeof(log_index_entry_t);
+    if (run < header->first_run || run > header->last_run) n = 0;
+
+    size_t first = 0, last = n;
+    if (header->sorted) {
+        // Prima voce con (entità, tempo) >= (entity, from_ms)
+        size_t lo = 0, hi = n;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (entries[mid].entity < entity || (entries[mid].entity == entity && entries[mid].timestamp_ms < from_ms)) lo = mid + 1;
+            else hi = mid;
+        }
+        first = lo;
+    }
+
+    long count = 0, capacity = 64;
+    uint64_t* offsets = malloc(capacity * sizeof(uint64_t));
+    for (size_t i = first; offsets && i < last; i++) {
+        if (entries[i].entity != entity || entries[i].timestamp_ms < from_ms || entries[i].timestamp_ms > to_ms) {
+            if (header->sorted) break; // Oltre l'intervallo dell'entità
+            continue;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            uint64_t* temp = realloc(offsets, capacity * sizeof(uint64_t));
+            if (!temp) break;
+            offsets = temp;
+        }
+        offsets[count++] = entries[i].offset;
+    }
+    munmap(map, st.st_size);
+    if (!offsets) return -1;
+    // Le righe vengono stampate nell'ordine in cui sono state scritte
+    qsort(offsets, count, sizeof(uint64_t), compare_offsets);
+    *out = offsets;
+    return count;
+}
+
+/**
+ * @brief Stampa le righe di un segmento non compresso leggendole direttamente agli offset indicati.
+ */
+static void print_plain(const char* path, const uint64_t* offsets, long count) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return;
+    }
+    char line[LOG_LINE_MAX + 1];
+    for (long i = 0; i < count; i++) {
+        if (i > 0 && offsets[i] == offsets[i - 1]) continue; // Riga indicizzata sotto più chiavi
+        ssize_t r = pread(fd, line, LOG_LINE_MAX, (off_t)offsets[i]);
+        if (r <= 0) continue;
+        line[r] = '\0';
+        char* nl = strchr(line, '\n');
+        if (nl) nl[1] = '\0';
+        fputs(line, stdout);
+    }
+    close(fd);
+}
+
+/**
+ * @brief Stampa le righe di un segmento compresso: lo decomprime in streaming e tiene solo gli offset indicati.
+ * gzip viene avviato direttamente (senza shell) e la sua uscita letta da una pipe: il percorso non viene mai interpretato.
+ */
+static void print_compressed(const char* path, const uint64_t* offsets, long count) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    pid_t pid;
+    char* argv[] = { "gzip", "-dc", (char*)path, NULL };
+    int err = posix_spawnp(&pid, "gzip", &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (err != 0) {
+        fprintf(stderr, "gzip: %s\n", strerror(err));
+        close(fds[0]);
+        return;
+    }
+    FILE* in = fdopen(fds[0], "r");
+    if (!in) {
+        perror("gzip");
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+        return;
+    }
+    char line[LOG_LINE_MAX + 1];
+    uint64_t pos = 0;
+    long next = 0;
+    while (next < count && fgets(line, sizeof(line), in)) {
+        size_t len = strlen(line);
+        while (next < count && offsets[next] < pos) next++;
+        if (next < count && offsets[next] == pos) {
+            fputs(line, stdout);
+            next++;
+        }
+        pos += len;
+    }
+    fclose(in); // gzip riceve SIGPIPE se non ha finito: le righe che servivano sono già state lette
+    waitpid(pid, NULL, 0);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "USAGE: %s (--emergency <id> | --rescuer <id>) [--run <n>] [--from <sec>] [--to <sec>] [--log <path>]\n", prog);
+    fprintf(stderr, "       senza --run viene interrogata l'ultima esecuzione registrata nel log\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* log_path = "system.log";
+    int cls = 0;
+    long id = -1;
+    long run = 0;
+    int64_t from_ms = INT64_MIN, to_ms = INT64_MAX;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--emergency") == 0) {
+            cls = LOG_ENTITY_EMERGENCY;
+            id = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--rescuer") == 0) {
+            cls = LOG_ENTITY_RESCUER;
+            id = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run = atol(argv[++i]);
+            if (run <= 0 || run > LOG_RUN_MAX) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--from") == 0) {
+            from_ms = atoll(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "--to") == 0) {
+            to_ms = atoll(argv[++i]) * 1000 + 999;
+        } else if (strcmp(argv[i], "--log") == 0) {
+            log_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!cls || id < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    segment_t* segments = NULL;
+    int segment_count = list_segments(log_path, &segments);
+    char data_path[300], idx_path[320];
+    if (run == 0) {
+        // Gli ID ripartono da 0 a ogni esecuzione: per default si interroga la più recente
+        for (int s = 0; s < segment_count; s++) {
+            segment_paths(log_path, &segments[s], data_path, sizeof(data_path), idx_path, sizeof(idx_path));
+            uint32_t last = index_last_run(idx_path);
+            if (last > run) run = last;
+        }
+    }
+    uint64_t entity = LOG_ENTITY_KEY(cls, run, id);
+
+    for (int s = 0; s < segment_count; s++) {
+        if (s > 0 && segments[s].number == segments[s - 1].number) continue; // Segmento già letto
+        segment_paths(log_path, &segments[s], data_path, sizeof(data_path), idx_path, sizeof(idx_path));
+        uint64_t* offsets = NULL;
+        long count = find_offsets(idx_path, (uint32_t)run, entity, from_ms, to_ms, &offsets);
+        if (count < 0) {
+            fprintf(stderr, "⚠️  Indice mancante o non valido per %s, segmento ignorato\n", data_path);
+            continue;
+        }
+        if (count > 0) {
+            if (segments[s].compressed) print_compressed(data_path, offsets, count);
+            else print_plain(data_path, offsets, count);
+        }
+        free(offsets);
+    }
+    free(segments);
+    return 0;
+}
@@ -5,15 +5,29 @@
 #include <time.h>
 #include "macros.h"
 #include <threads.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+#include "types.h"
+#include "log_file.h"
+#include "log_index.h"
 
-// Dimensione massima della coda dei messaggi di log
+// Dimensione massima della coda dei messaggi di log (potenza di 2)
 #define LOG_QUEUE_SIZE 1024
 
-// Struttura che rappresenta un messaggio di log
+// Struttura che rappresenta un messaggio di log: testo libero oppure evento strutturato
 typedef struct {
-    char id[32];         // ID associato all'evento (es. emergenza, soccorritore, ecc.)
-    char event[32];      // Categoria dell'evento (es. EMERGENCY_STATUS, FILE_PARSING, ecc.)
-    char message[256];   // Messaggio descrittivo dell'evento
+    long long timestamp_ms;  // Istante (in millisecondi) in cui l'evento è stato generato
+    int structured;          // 1 se il messaggio contiene un evento strutturato (record)
+    union {
+        struct {
+            char id[32];         // ID associato all'evento (es. emergenza, soccorritore, ecc.)
+            char event[32];      // Categoria dell'evento (es. EMERGENCY_STATUS, FILE_PARSING, ecc.)
+            char message[256];   // Messaggio descrittivo dell'evento
+            int entity_class;    // Entità sotto cui indicizzare la riga (LOG_ENTITY_*), 0 se nessuna
+            int entity_id;       // ID dell'entità indicizzata
+        } text;
+        log_record_t record;     // Evento strutturato, formattato solo dal thread logger
+    };
 } log_msg_t;
 
 
@@ -23,215 +37,615 @@ typedef struct {
 #include <netinet/in.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-int tcp_enabled = 0; // Flag per abilitare/disabilitare l'invio TCP
-char* tcp_server_ip = "127.0.0.1"; // Indirizzo IP del server TCP
-int tcp_server_port = 9000; // Porta del server TCP
-int tcp_sock_fd = -1; // File descriptor per la socket TCP
-void init_tcp_logger(); // Funzione per inizializzare la connessione TCP
-void send_log_json(const log_msg_t* msg); // Funzione per inviare messaggi JSON al server TCP
-
-
-
-// Coda circolare per i messaggi di log
-static log_msg_t log_queue[LOG_QUEUE_SIZE];
-// Indici di testa e coda della coda circolare
-static int log_head = 0, log_tail = 0;
-// Mutex per proteggere l'accesso concorrente alla coda
-static mtx_t log_mutex;
-// Condition variable per notificare il thread logger della presenza di nuovi messaggi
-static cnd_t log_cond;
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+
+// Dimensione del backlog di righe JSON in attesa di invio (conservate anche durante le disconnessioni)
+#define TCP_BACKLOG_SIZE (256 * 1024)
+// Attesa iniziale e massima tra due tentativi di connessione (millisecondi)
+#define TCP_RETRY_MIN_MS 250
+#define TCP_RETRY_MAX_MS 5000
+// Intervallo con cui il logger riprova a inviare quando la socket è piena (millisecondi)
+#define TCP_POLL_MS 20
+
+// Stato della connessione con il server TCP (usato solo dal thread logger)
+typedef enum { TCP_DISCONNECTED, TCP_CONNECTING, TCP_CONNECTED } tcp_state_t;
+
+static char* tcp_server_ip = "127.0.0.1"; // Indirizzo IP del server TCP
+static int tcp_server_port = 9000; // Porta del server TCP
+static int tcp_sock_fd = -1; // File descriptor (non bloccante) per la socket TCP
+static tcp_state_t tcp_state = TCP_DISCONNECTED;
+static long long tcp_retry_at = 0;            // Istante (ms, orologio monotono) del prossimo tentativo di connessione
+static long long tcp_retry_ms = TCP_RETRY_MIN_MS; // Attesa corrente tra i tentativi (backoff esponenziale)
+static int tcp_failure_reported = 0;          // Il fallimento della connessione viene segnalato una sola volta
+// Backlog circolare di righe JSON complete; le posizioni crescono sempre e vanno ridotte modulo la dimensione
+static char tcp_backlog[TCP_BACKLOG_SIZE];
+static size_t tcp_line_pos = 0;   // Inizio della riga più vecchia non ancora inviata per intero
+static size_t tcp_sent_pos = 0;   // Primo byte non ancora inviato
+static size_t tcp_end_pos = 0;    // Fine dei dati nel backlog
+static unsigned long tcp_dropped = 0; // Righe scartate perché il backlog era pieno
+static void tcp_service(); // Gestisce connessione e invio del backlog
+static int tcp_wait_ms(); // Tempo massimo di attesa del logger prima di dover servire la connessione TCP
+void send_log_json(const log_record_t* record); // Funzione per accodare messaggi JSON per il server TCP
+
+
+
+/**
+ * @brief Slot della coda dei messaggi di log.
+ * Il numero di sequenza indica a produttori e consumatore se lo slot è libero o pubblicato
+ * (coda limitata multi-produttore senza lock, alla Vyukov).
+ */
+typedef struct {
+    atomic_size_t seq;   // Sequenza dello slot: == posizione se libero, == posizione + 1 se pubblicato
+    log_msg_t msg;       // Messaggio contenuto nello slot
+} log_slot_t;
+
+// Coda circolare (multi-produttore, singolo consumatore) per i messaggi di log
+static log_slot_t log_queue[LOG_QUEUE_SIZE];
+// Prossima posizione da riservare per i produttori
+static atomic_size_t log_head = 0;
+// Prossima posizione da consumare (usata solo dal thread logger)
+static size_t log_tail = 0;
+// Messaggi scartati perché la coda era piena
+static atomic_ulong log_dropped = 0;
+// Semaforo con cui i produttori risvegliano il thread logger
+static sem_t log_sem;
+// Flag impostato dal thread logger prima di addormentarsi sul semaforo
+static atomic_int logger_waiting = 0;
 // Flag che indica se il logger deve continuare a funzionare
-static int logger_running = 1;
+static atomic_int logger_running = 1;
 // Variabile per il thread logger
 static thrd_t logger_thread;
+// Orologio usato per marcare gli eventi (NULL = orologio di sistema)
+static _Atomic(long long (*)(void)) log_clock = NULL;
+
+/**
+ * @brief Estrae il prossimo messaggio pubblicato dalla coda, copiandolo in out.
+ * Lo slot viene restituito ai produttori prima di qualunque operazione di I/O.
+ * @return 1 se è stato estratto un messaggio, 0 se la coda è vuota.
+ */
+static int log_queue_pop(log_msg_t* out) {
+    log_slot_t* slot = &log_queue[log_tail & (LOG_QUEUE_SIZE - 1)];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != log_tail + 1) return 0;
+    *out = slot->msg;
+    // Libera lo slot per il giro successivo della coda
+    atomic_store_explicit(&slot->seq, log_tail + LOG_QUEUE_SIZE, memory_order_release);
+    log_tail++;
+    return 1;
+}
+
+/**
+ * @brief Riserva uno slot libero della coda per un produttore, senza lock.
+ * @param pos Restituisce la posizione riservata, da passare a log_queue_publish.
+ * @return Messaggio dello slot riservato, NULL se la coda è piena (il messaggio viene scartato e conteggiato).
+ */
+static log_msg_t* log_queue_reserve(size_t* pos) {
+    size_t p = atomic_load_explicit(&log_head, memory_order_relaxed);
+    for (;;) {
+        log_slot_t* slot = &log_queue[p & (LOG_QUEUE_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == p) {
+            // Slot libero: prova a riservarlo (in caso di fallimento p viene aggiornato)
+            if (atomic_compare_exchange_weak_explicit(&log_head, &p, p + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                *pos = p;
+                // Marca l'evento nell'istante in cui viene generato (tempo virtuale se impostato)
+                long long (*clock)(void) = atomic_load_explicit(&log_clock, memory_order_relaxed);
+                slot->msg.timestamp_ms = clock ? clock() : (long long)time(NULL) * 1000;
+                return &slot->msg;
+            }
+        } else if (seq < p) {
+            // Lo slot contiene ancora un messaggio del giro precedente: coda piena, nessun overwrite
+            atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            p = atomic_load_explicit(&log_head, memory_order_relaxed); // Un altro produttore è avanzato
+        }
+    }
+}
+
+static void logger_wake();
+
+/**
+ * @brief Pubblica al thread logger lo slot riservato e lo risveglia se necessario.
+ */
+static void log_queue_publish(size_t pos) {
+    atomic_store_explicit(&log_queue[pos & (LOG_QUEUE_SIZE - 1)].seq, pos + 1, memory_order_release);
+    logger_wake();
+}
+
+/**
+ * @brief Indica se la coda contiene almeno un messaggio pubblicato.
+ */
+static int log_queue_ready() {
+    log_slot_t* slot = &log_queue[log_tail & (LOG_QUEUE_SIZE - 1)];
+    return atomic_load_explicit(&slot->seq, memory_order_acquire) == log_tail + 1;
+}
+
+/**
+ * @brief Categoria (colonna "evento" del log) di un evento strutturato.
+ */
+static const char* log_kind_name(log_kind_t kind) {
+    switch (kind) {
+        case LOG_RESCUER_INIT: return "RESCUER_INIT";
+        case LOG_EMERGENCY_INIT: return "EMERGENCY_INIT";
+        case LOG_RESCUER_STATUS: return "RESCUER_STATUS";
+        case LOG_EMERGENCY_STATUS: return "EMERGENCY_STATUS";
+        default: return "UNKNOWN_EVENT";
+    }
+}
+
+/**
+ * @brief Nome di uno stato del soccorritore.
+ */
+static const char* rescuer_status_name(int status) {
+    switch (status) {
+        case IDLE: return "IDLE";
+        case EN_ROUTE_TO_SCENE: return "EN_ROUTE_TO_SCENE";
+        case ON_SCENE: return "ON_SCENE";
+        case RETURNING_TO_BASE: return "RETURNING_TO_BASE";
+        default: return "UNKNOWN_STATUS";
+    }
+}
+
+/**
+ * @brief Nome di uno stato dell'emergenza.
+ */
+static const char* emergency_status_name(int status) {
+    switch (status) {
+        case WAITING: return "WAITING";
+        case ASSIGNED: return "ASSIGNED";
+        case IN_PROGRESS: return "IN_PROGRESS";
+        case PAUSED: return "PAUSED";
+        case COMPLETED: return "COMPLETED";
+        case CANCELED: return "CANCELED";
+        case TIMEOUT: return "TIMEOUT";
+        default: return "UNKNOWN_STATUS";
+    }
+}
+
+/**
+ * @brief Formatta il messaggio testuale di un evento strutturato (colonna "messaggio" di system.log).
+ */
+static void format_record(const log_record_t* r, char* buf, size_t size) {
+    switch (r->kind) {
+    case LOG_RESCUER_INIT:
+        snprintf(buf, size, "[(%s) (%d,%d)] Creato gemello digitale per %s", r->type_name, r->x, r->y, r->type_name);
+        break;
+    case LOG_EMERGENCY_INIT:
+        snprintf(buf, size, "[(%s) (%d,%d) (%s)] Emergenza correttamente aggiunta alla coda",
+            r->type_name, r->x, r->y, emergency_status_name(r->status));
+        break;
+    case LOG_RESCUER_STATUS: {
+        const char* st = rescuer_status_name(r->status);
+        switch (r->status) {
+        case EN_ROUTE_TO_SCENE:
+            snprintf(buf, size, "[(%s) (%s) (%d,%d) (%d)] Partenza verso il luogo dell'emergenza (%d,%d) -> (%d,%d) in %d sec.",
+                r->type_name, st, r->x, r->y, r->duration, r->from_x, r->from_y, r->to_x, r->to_y, r->duration);
+            break;
+        case ON_SCENE:
+            snprintf(buf, size, "[(%s) (%s) (%d,%d) (%d)] Intervento in corso a (%d,%d) in %d sec.",
+                r->type_name, st, r->x, r->y, r->duration, r->x, r->y, r->duration);
+            break;
+        case RETURNING_TO_BASE:
+            snprintf(buf, size, "[(%s) (%s) (%d,%d) (%d)] In rientro verso la base (%d,%d) -> (%d,%d) in %d sec.",
+                r->type_name, st, r->x, r->y, r->duration, r->from_x, r->from_y, r->to_x, r->to_y, r->duration);
+            break;
+        default:
+            snprintf(buf, size, "[(%s) (%s)] Intervento completato.", r->type_name, st);
+            break;
+        }
+        break;
+    }
+    case LOG_EMERGENCY_STATUS:
+        snprintf(buf, size, "[%s] Stato di emergenza aggiornato", emergency_status_name(r->status));
+        break;
+    default:
+        snprintf(buf, size, "Evento sconosciuto");
+        break;
+    }
+}
+
+/**
+ * @brief Registra nell'indice del log le entità a cui si riferisce la prossima riga.
+ * Le righe dei soccorritori in servizio sono indicizzate anche sotto l'emergenza che gestiscono,
+ * così il ciclo di vita completo di un'emergenza si ricostruisce da un'unica chiave.
+ */
+static void index_record(const log_record_t* r, long long timestamp_ms) {
+    switch (r->kind) {
+    case LOG_RESCUER_INIT:
+        log_file_index(LOG_ENTITY_RESCUER, r->entity_id, timestamp_ms);
+        break;
+    case LOG_RESCUER_STATUS:
+        log_file_index(LOG_ENTITY_RESCUER, r->entity_id, timestamp_ms);
+        if (r->status != IDLE) log_file_index(LOG_ENTITY_EMERGENCY, r->emergency_id, timestamp_ms);
+        break;
+    case LOG_EMERGENCY_INIT:
+    case LOG_EMERGENCY_STATUS:
+        log_file_index(LOG_ENTITY_EMERGENCY, r->entity_id, timestamp_ms);
+        break;
+    }
+}
 
 // Funzione eseguita dal thread logger: estrae messaggi dalla coda e li scrive su file
 static int logger_func(void* arg) {
-    FILE* f = fopen("system.log", "w"); // Apre il file di log in modalità append
-    CHECK_FOPEN("1200",f, "system.log");
-    if (!f) return 1; // Se non riesce ad aprire il file, termina il thread
-    while (logger_running || log_head != log_tail) { // Continua finché il logger è attivo o ci sono messaggi da scrivere
-        mtx_lock(&log_mutex); // Blocca il mutex per accedere alla coda
-        while (log_head == log_tail && logger_running) { // Se la coda è vuota e il logger è attivo, aspetta nuovi messaggi
-            cnd_wait(&log_cond, &log_mutex);
+    // Apre il file di log in append: lo storico delle esecuzioni precedenti viene conservato
+    if (log_file_open("system.log") != 0) {
+        perror("❌ Errore nell'apertura del file system.log");
+        return 1; // Se non riesce ad aprire il file, termina il thread
+    }
+    unsigned long reported_drops = 0; // Messaggi scartati già segnalati nel log
+    unsigned long reported_tcp_drops = 0; // Righe JSON scartate già segnalate nel log
+    log_msg_t msg;
+    while (atomic_load(&logger_running) || log_queue_ready()) { // Continua finché il logger è attivo o ci sono messaggi da scrivere
+        // Scrive tutti i messaggi disponibili: nessun lock è tenuto durante l'I/O
+        while (log_queue_pop(&msg)) {
+            long timestamp = (long)(msg.timestamp_ms / 1000);
+            if (!msg.structured) {
+                // Scrive il messaggio di log nel file con il formato richiesto
+                if (msg.text.entity_class) log_file_index(msg.text.entity_class, msg.text.entity_id, msg.timestamp_ms);
+                log_file_printf("[%ld] [%s] [%s] %s\n", timestamp, msg.text.id, msg.text.event, msg.text.message);
+                continue;
+            }
+            // Evento strutturato: formattato qui, una sola volta, in testo e in JSON
+            index_record(&msg.record, msg.timestamp_ms);
+            char line[256];
+            format_record(&msg.record, line, sizeof(line));
+            log_file_printf("[%ld] [%d%03d] [%s] %s\n", timestamp, msg.record.error, msg.record.entity_id,
+                    log_kind_name(msg.record.kind), line);
+
+            // Accoda il JSON per il server TCP (inviato in blocco dopo la scrittura su file)
+            send_log_json(&msg.record);
+        }
+        // Segnala i messaggi persi perché la coda era piena
+        unsigned long drops = atomic_load(&log_dropped);
+        if (drops != reported_drops) {
+            log_file_printf("[%ld] [1201] [LOGGER] Coda di log piena: %lu messaggi scartati (%lu in totale)\n",
+                    (long)time(NULL), drops - reported_drops, drops);
+            reported_drops = drops;
         }
-        while (log_head != log_tail) { // Finché ci sono messaggi nella coda
-            log_msg_t* msg = &log_queue[log_tail]; // Prende il messaggio in testa alla coda
-            long timestamp = (long)time(NULL); // Ottiene il timestamp corrente
-            // Scrive il messaggio di log nel file con il formato richiesto
-            fprintf(f, "[%ld] [%s] [%s] %s\n", timestamp, msg->id, msg->event, msg->message);
+        if (tcp_dropped != reported_tcp_drops) {
+            log_file_printf("[%ld] [1202] [LOGGER] Backlog TCP pieno: %lu righe JSON scartate (%lu in totale)\n",
+                    (long)time(NULL), tcp_dropped - reported_tcp_drops, tcp_dropped);
+            reported_tcp_drops = tcp_dropped;
+        }
+        log_file_tick(); // Flush e rotazione secondo le politiche di dimensione e tempo
 
-            // INVIO TCP
-            if (tcp_enabled) send_log_json(msg);
+        // INVIO TCP: non bloccante, al più una chiamata di sistema per l'intero backlog
+        tcp_service();
 
-            log_tail = (log_tail + 1) % LOG_QUEUE_SIZE; // Avanza la coda
+        // Si addormenta solo se, dopo aver annunciato l'attesa, la coda è ancora vuota
+        atomic_store(&logger_waiting, 1);
+        atomic_thread_fence(memory_order_seq_cst); // Ordina l'annuncio rispetto alla verifica della coda
+        if (!log_queue_ready() && atomic_load(&logger_running)) {
+            // Si risveglia in tempo per il prossimo flush del file o per servire la connessione TCP
+            int wait_ms = tcp_wait_ms();
+            int file_wait_ms = log_file_wait_ms();
+            if (wait_ms < 0 || (file_wait_ms >= 0 && file_wait_ms < wait_ms)) wait_ms = file_wait_ms;
+            if (wait_ms < 0) {
+                while (sem_wait(&log_sem) != 0 && errno == EINTR) {} // Riprova se interrotto da un segnale
+            } else {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += wait_ms / 1000;
+                deadline.tv_nsec += (long)(wait_ms % 1000) * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000L;
+                }
+                while (sem_timedwait(&log_sem, &deadline) != 0 && errno == EINTR) {}
+            }
         }
-        fflush(f); // Forza la scrittura su disco
-        mtx_unlock(&log_mutex); // Sblocca il mutex
+        atomic_store(&logger_waiting, 0);
     }
-    fclose(f); // Chiude il file di log
+    tcp_service(); // Ultimo tentativo di consegnare il backlog
+    log_file_close(); // Scrive il buffer residuo e chiude il file di log
     return 0;
 }
 
+/**
+ * @brief Risveglia il thread logger se è in attesa di nuovi messaggi.
+ */
+static void logger_wake() {
+    atomic_thread_fence(memory_order_seq_cst); // Ordina la pubblicazione rispetto alla lettura del flag
+    if (atomic_load_explicit(&logger_waiting, memory_order_relaxed) && atomic_exchange(&logger_waiting, 0)) {
+        sem_post(&log_sem);
+    }
+}
+
 // Avvia il thread logger
 void start_logger_thread() {
-    thrd_create(&logger_thread, logger_func, NULL);
-
-    //INIZIALIZZA TCP
-    init_tcp_logger(); // Inizializza la connessione TCP al server
+    // Ogni slot parte libero per la sua posizione nel primo giro della coda
+    for (size_t i = 0; i < LOG_QUEUE_SIZE; i++) atomic_init(&log_queue[i].seq, i);
+    sem_init(&log_sem, 0, 0);
+    thrd_create(&logger_thread, logger_func, NULL); // Il thread logger gestisce anche la connessione TCP
 }
 
 // Ferma il thread logger e attende la sua terminazione
 void stop_logger_thread() {
-    mtx_lock(&log_mutex);
-    logger_running = 0; // Imposta il flag per terminare il logger
-    cnd_signal(&log_cond); // Risveglia il thread logger se in attesa
-    mtx_unlock(&log_mutex);
+    atomic_store(&logger_running, 0); // Imposta il flag per terminare il logger
+    sem_post(&log_sem); // Risveglia il thread logger se in attesa
     thrd_join(logger_thread, NULL); // Attende la terminazione del thread logger
+    sem_destroy(&log_sem);
 
     //CHIUSURA TCP
-    close(tcp_sock_fd); // Chiude la socket TCP
-    tcp_enabled = 0; // Disabilita l'invio TCP
+    if (tcp_sock_fd >= 0) close(tcp_sock_fd); // Chiude la socket TCP
     tcp_sock_fd = -1; // Resetta il file descriptor della socket TCP
+    tcp_state = TCP_DISCONNECTED;
+}
+
+/**
+ * @brief Accoda un messaggio di testo, indicizzato sotto l'entità indicata (classe 0: non indicizzato).
+ */
+static void log_text(int entity_class, int entity_id, const char* id, const char* event, const char* message) {
+    size_t pos;
+    log_msg_t* msg = log_queue_reserve(&pos);
+    if (!msg) return;
+
+    // Copia i dati del messaggio nello slot riservato
+    msg->structured = 0;
+    msg->text.entity_class = entity_class;
+    msg->text.entity_id = entity_id;
+    strncpy(msg->text.id, id, 31);
+    strncpy(msg->text.event, event, 31);
+    strncpy(msg->text.message, message, 255);
+    msg->text.id[31] = 0;
+    msg->text.event[31] = 0;
+    msg->text.message[255] = 0;
+    log_queue_publish(pos);
 }
 
 /**
  * @brief Inserisce un nuovo messaggio di log nella coda.
+ * Non acquisisce lock e non attende mai il thread logger: se la coda è piena
+ * il messaggio viene scartato e conteggiato.
  * @param id ID associato all'evento (es. emergenza, soccorritore, ecc.)
  * @param event Categoria dell'evento (es. EMERGENCY_STATUS, FILE_PARSING, ecc.)
  * @param message Messaggio descrittivo dell'evento
  */
 void log_event(const char* id, const char* event, const char* message) {
-    mtx_lock(&log_mutex); // Blocca il mutex per accedere alla coda
-    int next_head = (log_head + 1) % LOG_QUEUE_SIZE; // Calcola la prossima posizione della testa
-    if (next_head != log_tail) { // Se la coda non è piena
-        // Copia i dati del messaggio nella coda circolare
-        strncpy(log_queue[log_head].id, id, 31);
-        strncpy(log_queue[log_head].event, event, 31);
-        strncpy(log_queue[log_head].message, message, 255);
-        log_queue[log_head].id[31] = 0;
-        log_queue[log_head].event[31] = 0;
-        log_queue[log_head].message[255] = 0;
-        log_head = next_head; // Avanza la testa della coda
-        cnd_signal(&log_cond); // Notifica il thread logger della presenza di un nuovo messaggio
-    }
-    // Se la coda è piena il messaggio viene scartato (nessun overwrite)
-    mtx_unlock(&log_mutex); // Sblocca il mutex
+    log_text(0, 0, id, event, message);
+}
+
+/**
+ * @brief Come log_event, ma la riga viene indicizzata sotto l'emergenza indicata (vedi log_query).
+ * @param emergency_id ID dell'emergenza a cui si riferisce il messaggio.
+ */
+void log_emergency_event(int emergency_id, const char* id, const char* event, const char* message) {
+    log_text(LOG_ENTITY_EMERGENCY, emergency_id, id, event, message);
+}
+
+/**
+ * @brief Come log_event, ma la riga viene indicizzata sotto il soccorritore indicato (vedi log_query).
+ * @param rescuer_id ID del gemello digitale a cui si riferisce il messaggio.
+ */
+void log_rescuer_event(int rescuer_id, const char* id, const char* event, const char* message) {
+    log_text(LOG_ENTITY_RESCUER, rescuer_id, id, event, message);
+}
+
+/**
+ * @brief Inserisce un evento strutturato nella coda di log.
+ * Il record viene copiato senza formattazione: testo e JSON sono prodotti dal thread logger.
+ * Come log_event, non acquisisce lock e scarta l'evento se la coda è piena.
+ * @param record Evento da registrare.
+ */
+void log_record(const log_record_t* record) {
+    size_t pos;
+    log_msg_t* msg = log_queue_reserve(&pos);
+    if (!msg) return;
+    msg->structured = 1;
+    msg->record = *record;
+    log_queue_publish(pos);
+}
+
+/**
+ * @brief Restituisce il numero di messaggi di log scartati perché la coda era piena.
+ */
+unsigned long log_dropped_count() {
+    return atomic_load(&log_dropped);
+}
+
+/**
+ * @brief Imposta l'orologio con cui vengono marcati gli eventi di log.
+ * @param now_ms Funzione che restituisce l'istante corrente in millisecondi dall'epoch
+ *               (es. l'orologio virtuale della simulazione), NULL per l'orologio di sistema.
+ */
+void log_set_clock(long long (*now_ms)(void)) {
+    atomic_store(&log_clock, now_ms);
 }
 
 // AGGIUNTE PER INVIO MESSAGGI A SERVER TCP
 
 /**
- * @brief Inizializza la connessione TCP al server per l'invio dei log.
- * Se la connessione fallisce, il logging TCP viene disabilitato.
+ * @brief Istante corrente in millisecondi sull'orologio monotono (per backoff e attese).
  */
-void init_tcp_logger() {
-    // Inizializza la connessione TCP al server
-    // Questa funzione serve per connettersi a un server TCP
-    // e inviare i messaggi di log direttamente al server.
+static long long tcp_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Chiude la connessione e programma un nuovo tentativo con backoff esponenziale.
+ * La riga eventualmente inviata solo in parte verrà ritrasmessa per intero alla riconnessione.
+ */
+static void tcp_disconnect() {
+    if (tcp_sock_fd >= 0) close(tcp_sock_fd);
+    tcp_sock_fd = -1;
+    tcp_state = TCP_DISCONNECTED;
+    tcp_sent_pos = tcp_line_pos;
+    tcp_retry_at = tcp_now_ms() + tcp_retry_ms;
+    tcp_retry_ms = tcp_retry_ms * 2 > TCP_RETRY_MAX_MS ? TCP_RETRY_MAX_MS : tcp_retry_ms * 2;
+}
+
+/**
+ * @brief Connessione stabilita: azzera il backoff (il backlog riparte dalla riga più vecchia non consegnata).
+ */
+static void tcp_connected() {
+    tcp_state = TCP_CONNECTED;
+    tcp_retry_ms = TCP_RETRY_MIN_MS;
+    tcp_failure_reported = 0;
+    printf("✅ TCP logger: connected to %s:%d\n", tcp_server_ip, tcp_server_port);
+}
+
+/**
+ * @brief Avvia (senza bloccare) un tentativo di connessione al server TCP.
+ */
+static void tcp_connect() {
     tcp_sock_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (tcp_sock_fd < 0) {
         perror("❌ Socket creation failed");
-        tcp_enabled = 0;
+        tcp_disconnect();
+        return;
+    }
+    fcntl(tcp_sock_fd, F_SETFL, fcntl(tcp_sock_fd, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(tcp_server_port);
+    inet_pton(AF_INET, tcp_server_ip, &addr.sin_addr);
+
+    // Tenta la connessione al server TCP (tipicamente resta in corso: verrà completata da tcp_service)
+    if (connect(tcp_sock_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        tcp_connected();
+    } else if (errno == EINPROGRESS) {
+        tcp_state = TCP_CONNECTING;
     } else {
-        struct sockaddr_in addr = {0};
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(tcp_server_port);
-        inet_pton(AF_INET, tcp_server_ip, &addr.sin_addr);
-
-        // Tenta la connessione al server TCP
-        if (connect(tcp_sock_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-            printf("❌ [TCP]: connection failed, continuing without TCP\n");
-            close(tcp_sock_fd);
-            tcp_enabled = 0;
-        } else {
-            printf("✅ TCP logger: connected to %s:%d\n", tcp_server_ip, tcp_server_port);
-            tcp_enabled = 1; // Abilita l'invio TCP se la connessione ha successo
-        }
+        tcp_disconnect();
     }
 }
 
-void send_log_json(const log_msg_t* msg) {
-    if (!tcp_enabled || tcp_sock_fd < 0) return;
-    char mess[256] = "";
-    // int temp_int = 0;
-
-    if(strcmp(msg->event, "RESCUER_INIT") == 0) {
-        int x, y;
-        char type[32], type2[32];
-        //%[^)] per leggere tutto fino a ')'
-        if (sscanf(msg->message, "[(%31[^)]) (%d,%d)] Creato gemello digitale per %31[^]]", type, &x, &y, type2) == 4) {
-            snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"x\":%d, \"y\":%d",type, x, y);
-        } else {
-            return; // fallback
+/**
+ * @brief Gestisce la connessione al server TCP e invia il backlog senza mai bloccare.
+ * Le righe in attesa vengono inviate in blocco con una sola sendmsg (scatter/gather, come writev).
+ */
+static void tcp_service() {
+    if (tcp_state == TCP_DISCONNECTED) {
+        if (tcp_now_ms() < tcp_retry_at) return;
+        tcp_connect();
+    }
+    if (tcp_state == TCP_CONNECTING) {
+        // La connessione è completata quando la socket diventa scrivibile
+        struct pollfd pfd = { .fd = tcp_sock_fd, .events = POLLOUT };
+        if (poll(&pfd, 1, 0) <= 0) return;
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(tcp_sock_fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            if (!tcp_failure_reported) {
+                printf("❌ [TCP]: connection failed, continuing without TCP (retrying in background)\n");
+                tcp_failure_reported = 1;
+            }
+            tcp_disconnect();
+            return;
         }
-    }    
-    else if(strcmp(msg->event, "EMERGENCY_INIT") == 0) {
-        int x, y;
-        char type[32], status[32];
-        //%[^)] per leggere tutto fino a ')'
-        if (sscanf(msg->message, "[(%31[^)]) (%d,%d) (%31[^)])] Emergenza correttamente aggiunta alla coda", type, &x, &y, status) == 4) {
-            snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"x\":%d, \"y\":%d, \"status\":\"%s\"",type, x, y, status);
-        } else {
-            return; // fallback
+        tcp_connected();
+    }
+    if (tcp_state != TCP_CONNECTED) return;
+
+    // Invia tutto il backlog non ancora trasmesso (al più due segmenti del buffer circolare)
+    while (tcp_sent_pos < tcp_end_pos) {
+        struct iovec iov[2];
+        int iovcnt = 0;
+        size_t start = tcp_sent_pos % TCP_BACKLOG_SIZE;
+        size_t pending = tcp_end_pos - tcp_sent_pos;
+        size_t first = TCP_BACKLOG_SIZE - start < pending ? TCP_BACKLOG_SIZE - start : pending;
+        iov[iovcnt++] = (struct iovec){ .iov_base = tcp_backlog + start, .iov_len = first };
+        if (pending > first) iov[iovcnt++] = (struct iovec){ .iov_base = tcp_backlog, .iov_len = pending - first };
+        struct msghdr mh = { .msg_iov = iov, .msg_iovlen = iovcnt };
+
+        ssize_t sent = sendmsg(tcp_sock_fd, &mh, MSG_NOSIGNAL); // Niente SIGPIPE se il server chiude
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return; // Socket piena: si riprova più tardi
+            perror("❌ Error sending log JSON");
+            tcp_disconnect();
+            return;
         }
-    }    
-    else if(strcmp(msg->event, "RESCUER_STATUS") == 0) {
-        int x, y, time, t1, t2, t3, t4, t5;
-        char type[32], status[32];
-        //%[^)] per leggere tutto fino a ')'
-
-        if (sscanf(msg->message, "[(%31[^)]) (%31[^)]) (%d,%d) (%d)] Partenza verso il luogo dell'emergenza (%d,%d) -> (%d,%d) in %d sec.",
-                type, status, &x, &y, &time, &t1, &t2, &t3, &t4, &t5) == 10) {
-            // EN_ROUTE_TO_SCENE
-            snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"x\":%d, \"y\":%d, \"time\":%d, \"status\":\"%s\"",
-                type, x, y,time, status);
-        } else if (sscanf(msg->message, "[(%31[^)]) (%31[^)]) (%d,%d) (%d)] Intervento in corso a (%d,%d) in %d sec.",
-                type, status, &x, &y, &time, &t1, &t2, &t3) == 8) {
-            // ON_SCENE
-            snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"x\":%d, \"y\":%d, \"time\":%d, \"status\":\"%s\"",
-            type, x, y,time, status);
-        } else if (sscanf(msg->message, "[(%31[^)]) (%31[^)]) (%d,%d) (%d)] Rientrato alla base (%d,%d) -> (%d,%d) in %d sec.",
-                type, status, &x, &y, &time, &t1, &t2, &t3, &t4, &t5) == 10) {
-            // RETURNING_TO_BASE
-            snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"x\":%d, \"y\":%d, \"time\":%d, \"status\":\"%s\"",
-                type, x, y,time, status);
-        } else if (sscanf(msg->message, "[(%31[^)]) (%31[^)])] Intervento completato.",
-                type, status) == 2) {
-            // IDLE
-            snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"status\":\"%s\"",
-                type, status);
-        } else {
-            return; // fallback
+        tcp_sent_pos += (size_t)sent;
+        // Le righe inviate per intero liberano spazio nel backlog
+        for (size_t pos = tcp_sent_pos; pos > tcp_line_pos; pos--) {
+            if (tcp_backlog[(pos - 1) % TCP_BACKLOG_SIZE] == '\n') {
+                tcp_line_pos = pos;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Tempo massimo (ms) che il logger può attendere prima di dover servire la connessione TCP.
+ * @return -1 se non c'è nulla da fare finché non arrivano nuovi messaggi.
+ */
+static int tcp_wait_ms() {
+    if (tcp_state == TCP_DISCONNECTED) {
+        long long wait = tcp_retry_at - tcp_now_ms();
+        return wait < 0 ? 0 : (int)wait;
+    }
+    if (tcp_state == TCP_CONNECTING || tcp_sent_pos < tcp_end_pos) return TCP_POLL_MS;
+    return -1;
+}
+
+/**
+ * @brief Accoda una riga JSON nel backlog TCP.
+ * Se il backlog è pieno vengono scartate le righe più vecchie non ancora inviate
+ * (o la nuova riga, se quella più vecchia è in corso di invio).
+ */
+static void tcp_enqueue(const char* line, size_t len) {
+    if (len > TCP_BACKLOG_SIZE) return;
+    while (tcp_end_pos - tcp_line_pos + len > TCP_BACKLOG_SIZE) {
+        if (tcp_sent_pos > tcp_line_pos) { // La riga più vecchia è già parzialmente sul socket
+            tcp_dropped++;
+            return;
         }
-    }    
-    else if(strcmp(msg->event, "EMERGENCY_STATUS") == 0) {
-        char status[32];
-        //%[^)] per leggere tutto fino a ')'
-        if (sscanf(msg->message, "[%31[^]]] Stato di emergenza aggiornato",status) == 1) {
-            snprintf(mess, sizeof(mess),"\"status\":\"%s\"",status);
+        // Scarta la riga più vecchia
+        size_t pos = tcp_line_pos;
+        while (tcp_backlog[pos % TCP_BACKLOG_SIZE] != '\n') pos++;
+        tcp_line_pos = tcp_sent_pos = pos + 1;
+        tcp_dropped++;
+    }
+    size_t start = tcp_end_pos % TCP_BACKLOG_SIZE;
+    size_t first = TCP_BACKLOG_SIZE - start < len ? TCP_BACKLOG_SIZE - start : len;
+    memcpy(tcp_backlog + start, line, first);
+    memcpy(tcp_backlog, line + first, len - first);
+    tcp_end_pos += len;
+}
+
+/**
+ * @brief Formatta un evento strutturato in JSON e lo accoda per il server TCP.
+ * @param record Evento da inviare.
+ */
+void send_log_json(const log_record_t* record) {
+    char mess[256] = "";
+
+    switch (record->kind) {
+    case LOG_RESCUER_INIT:
+        snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"x\":%d, \"y\":%d", record->type_name, record->x, record->y);
+        break;
+    case LOG_EMERGENCY_INIT:
+        snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"x\":%d, \"y\":%d, \"status\":\"%s\"",
+            record->type_name, record->x, record->y, emergency_status_name(record->status));
+        break;
+    case LOG_RESCUER_STATUS:
+        if (record->status == IDLE) {
+            snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"status\":\"%s\"",
+                record->type_name, rescuer_status_name(record->status));
         } else {
-            return; // fallback
+            snprintf(mess, sizeof(mess),"\"type\":\"%s\", \"x\":%d, \"y\":%d, \"time\":%d, \"status\":\"%s\"",
+                record->type_name, record->x, record->y, record->duration, rescuer_status_name(record->status));
         }
-    }    
-    else{
-        return;
+        break;
+    case LOG_EMERGENCY_STATUS:
+        snprintf(mess, sizeof(mess),"\"status\":\"%s\"", emergency_status_name(record->status));
+        break;
     }
 
     char json_msg[512];
     // Serializza semplice JSON
-    char id[32];
-    int num = atoi(msg->id);
-    snprintf(id, sizeof(id), "%03d", num % 1000);
     snprintf(json_msg, sizeof(json_msg),
-             "{\"id\":\"%s\", \"event\":\"%s\", %s}\n",
-             id, msg->event, mess);
+             "{\"id\":\"%03d\", \"event\":\"%s\", %s}\n",
+             record->entity_id % 1000, log_kind_name(record->kind), mess);
 
-    // Invia la stringa JSON via TCP
-    ssize_t sent = send(tcp_sock_fd, json_msg, strlen(json_msg), 0);
-    if (sent < 0) {
-        perror("❌ Error sending log JSON");
-        tcp_enabled = 0;
-        close(tcp_sock_fd);
-    }
-}
\ No newline at end of file
+    // Accoda la stringa JSON: l'invio avviene in blocco da tcp_service
+    tcp_enqueue(json_msg, strlen(json_msg));
+}
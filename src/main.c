@@ -9,18 +9,63 @@
 #include "mq_receiver.h"
 #include "rescuer.h"
 #include "scheduler.h"
+#include "rescuer_pool.h"
+#include "waitlist.h"
+#include "movement.h"
+#include "fleet.h"
+#include "eta_table.h"
+#include "emergency_pool.h"
+#include "sim_clock.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <threads.h>
+#include <signal.h>
 #include "logger.h"
 #include "macros.h"
 
-int main() {
+int main(int argc, char* argv[]) {
+
+    // ------ ARGOMENTI ------
+    // --time-scale <fattore|max>: accelera il tempo simulato (es. 1000) o lo fa avanzare il più veloce possibile
+    // --workers <n>: numero di thread che eseguono le transizioni di stato dei soccorritori
+    // --batch-window <ms>: raccoglie le emergenze per ms millisecondi e le assegna insieme (0 = greedy)
+    double time_scale = 1.0;
+    int workers = 4;
+    int batch_window_ms = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--time-scale") == 0 && i + 1 < argc) {
+            i++;
+            time_scale = strcmp(argv[i], "max") == 0 ? 0 : atof(argv[i]);
+            if (time_scale < 0) time_scale = 1.0;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+            if (workers < 1) workers = 1;
+        } else if (strcmp(argv[i], "--batch-window") == 0 && i + 1 < argc) {
+            batch_window_ms = atoi(argv[++i]);
+            if (batch_window_ms < 0) batch_window_ms = 0;
+        } else {
+            fprintf(stderr, "USAGE: %s [--time-scale <fattore|max>] [--workers <n>] [--batch-window <ms>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // ------ SEGNALI ------
+    // SIGINT/SIGTERM vengono bloccati in tutti i thread (che ereditano la maschera) e attesi dal main,
+    // così all'arresto il logger può scrivere su disco i messaggi ancora nel buffer
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
 
     // ------ LOGGER ------
     start_logger_thread(); // Avvia il thread logger
 
+    // ------ OROLOGIO VIRTUALE ------
+    sim_init(time_scale, workers); // Avvia il motore ad eventi discreti e i suoi worker
+    log_set_clock(sim_now);        // Gli eventi di log sono marcati con il tempo virtuale
+
     // ------ PARSING DELL'AMBIENTE ------
     env_config_t env_config;
     if (load_env_config("./conf/env.conf", &env_config) != 0) {
@@ -34,20 +79,20 @@ int main() {
     load_rescuer_types("./conf/rescuers.conf", &rescuer_types_info, &rescuer_count);
 
     rescuer_type_t rescuer_types[rescuer_count];
+    int rescuer_types_count = 0; // Tipi validi (dentro la mappa), ognuno mantiene il proprio ID
     for (int i = 0; i < rescuer_count; ++i) {
         if(rescuer_types_info[i].rescuer_type.x > env_config.width || rescuer_types_info[i].rescuer_type.y > env_config.height) {
             char log_msg[256];
             snprintf(log_msg, sizeof(log_msg), "Soccorritore (%s) fori limiti di mappa", rescuer_types_info[i].rescuer_type.rescuer_type_name);
             log_event("1022", "FILE_PARSING", log_msg); // Logga il soccorritore non valido
         }else{
-            rescuer_types[i] = rescuer_types_info[i].rescuer_type;
+            rescuer_types[rescuer_types_count++] = rescuer_types_info[i].rescuer_type;
             char log_msg[256];
             snprintf(log_msg, sizeof(log_msg), "Soccorritore (%s) correttamente caricata da file", rescuer_types_info[i].rescuer_type.rescuer_type_name);
             log_event("0022", "FILE_PARSING", log_msg); // Logga il soccorritore caricato
         }
         
     }
-    int rescuer_types_count = sizeof(rescuer_types) / sizeof(rescuer_types[0]);
 
 
     // ------ PARSING DELLE EMERGENZE ------
@@ -61,10 +106,21 @@ int main() {
         total_rescuers += rescuer_types_info[i].count;
     }
 
+    // Precalcola (o carica dalla cache) i tempi di viaggio dalla base di ogni tipo
+    eta_table_init(rescuer_types_info, rescuer_count, env_config.width, env_config.height, env_config.eta_cache_dir);
+    // Crea i pool dei soccorritori liberi, uno per tipo
+    rescuer_pool_init(rescuer_types_info, rescuer_count, env_config.width, env_config.height);
+    // e le liste d'attesa delle emergenze rimaste senza soccorritori liberi
+    waitlist_init(rescuer_types_info, rescuer_count);
+    // Comportamento dei soccorritori a fine intervento
+    rescuer_set_return_to_base(env_config.return_to_base);
+
     // Alloca e avvia i thread dei digital twin
     int idx = 0;
     rescuer_thread_t* rescuers_twin_thread = malloc(total_rescuers * sizeof(rescuer_thread_t)); 
     CHECK_MALLOC(rescuers_twin_thread, label);
+    fleet_init(total_rescuers); // Stato dei soccorritori in array contigui per le scansioni della flotta
+    movement_init(total_rescuers); // Posizioni continue dei soccorritori
     for (int i = 0; i < rescuer_count; ++i) {
         for (int j = 0; j < rescuer_types_info[i].count; ++j) {
             rescuers_twin_thread[idx].twin = malloc(sizeof(rescuer_digital_twin_t));
@@ -74,23 +130,27 @@ int main() {
             rescuers_twin_thread[idx].twin->y = rescuer_types_info[i].rescuer_type.y;
             rescuers_twin_thread[idx].twin->rescuer = &rescuer_types_info[i].rescuer_type;
             rescuers_twin_thread[idx].twin->status = IDLE;
-            start_rescuer(&rescuers_twin_thread[idx]); // Avvia il thread del soccorritore
-            //logga la creazione del gemello digitale
-            char log_msg[256];
-            snprintf(log_msg, sizeof(log_msg), "[(%s) (%d,%d)] Creato gemello digitale per %s",
-                rescuers_twin_thread[idx].twin->rescuer->rescuer_type_name,
-                rescuers_twin_thread[idx].twin->x,
-                rescuers_twin_thread[idx].twin->y,
-                rescuers_twin_thread[idx].twin->rescuer->rescuer_type_name);
-            char id [5];
-            snprintf(id, sizeof(id), "0%03d", rescuers_twin_thread[idx].twin->id);
-            log_event(id, "RESCUER_INIT", log_msg); // Logga la creazione del gemello digitale
+            rescuers_twin_thread[idx].current_em = NULL;
+            rescuers_twin_thread[idx].next_idle = NULL;
+            rescuers_twin_thread[idx].prev_idle = NULL;
+            rescuers_twin_thread[idx].idle_spot = NULL;
+            fleet_set_type(idx, rescuer_types_info[i].rescuer_type.id);
+            movement_stop(idx, rescuers_twin_thread[idx].twin->x, rescuers_twin_thread[idx].twin->y); // Fermo alla base
+            start_rescuer(&rescuers_twin_thread[idx]); // Prepara mutex e timer del soccorritore
+            rescuer_pool_put(&rescuers_twin_thread[idx]); // Il soccorritore parte libero
+            // Logga la creazione del gemello digitale
+            log_record(&(log_record_t){ .kind = LOG_RESCUER_INIT, .entity_id = rescuers_twin_thread[idx].twin->id,
+                .type_name = rescuers_twin_thread[idx].twin->rescuer->rescuer_type_name,
+                .x = rescuers_twin_thread[idx].twin->x, .y = rescuers_twin_thread[idx].twin->y });
             idx++;
         }
     }
 
+    // Prepara il pool delle emergenze (array di assegnazione dimensionati sui tipi caricati)
+    emergency_pool_init(emergency_types, emergency_count);
+
     //------PROVE CODA------
-    emergency_queue_init(); // Inizializza la coda delle emergenze
+    emergency_queue_init(env_config.queue_soft_limit, env_config.queue_hard_limit); // Inizializza la coda delle emergenze
 
     // ------ AVVIO THREAD MQ RECEIVER ------
     thrd_t mq_thread;
@@ -101,11 +161,17 @@ int main() {
     CHECK_MALLOC(args, label);
     args->rescuer_count = total_rescuers;
     args->rescuers = rescuers_twin_thread;
+    args->batch_window_ms = batch_window_ms;
     thrd_t scheduler_thread;
     thrd_create(&scheduler_thread, scheduler_thread_fun, args);
 
-    // Attende la fine del thread scheduler (il programma resta attivo)
-    thrd_join(scheduler_thread, NULL);
+    // Il programma resta attivo fino a SIGINT/SIGTERM, poi chiude il log in modo ordinato
+    int sig;
+    sigwait(&stop_signals, &sig);
+    printf("🛑 Arresto richiesto (%s)\n", sig == SIGINT ? "SIGINT" : "SIGTERM");
+    log_event("0600", "SHUTDOWN", "Arresto del sistema richiesto");
+    stop_logger_thread();
+    return 0;
     label:
     printf("❌ Errore durante l'esecuzione del programma\n");
     free(args);
@@ -0,0 +1,121 @@
+#include "movement.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "macros.h"
+#include "fleet.h"
+
+/**
+ * @brief Tratto di viaggio in corso di un soccorritore.
+ */
+typedef struct {
+    int from_x;                     // Coordinata X di partenza
+    int from_y;                     // Coordinata Y di partenza
+    int to_x;                       // Coordinata X di arrivo
+    int to_y;                       // Coordinata Y di arrivo
+    sim_time_t start;               // Istante virtuale di partenza (ms)
+    sim_time_t duration;            // Durata del viaggio (ms)
+} motion_t;
+
+// Tratti di viaggio, indicizzati per ID del gemello digitale
+static motion_t* motions = NULL;
+// ID dei soccorritori in movimento (array denso scorso a ogni passo) e loro indice in moving (-1 = fermo)
+static int* moving = NULL;
+static int* moving_slot = NULL;
+static int moving_count = 0;
+static int unit_count = 0;
+
+static int ticking = 0;             // 1 se il timer del passo è programmato
+static sim_timer_t tick_timer;
+static mtx_t movement_mutex;
+
+/**
+ * @brief Callback del timer del passo: avanza tutti i soccorritori in movimento.
+ */
+static void movement_tick(void* arg) {
+    (void)arg;
+    mtx_lock(&movement_mutex);
+    sim_time_t now = sim_now();
+    for (int i = 0; i < moving_count; i++) {
+        const motion_t* m = &motions[moving[i]];
+        sim_time_t elapsed = now - m->start;
+        if (elapsed < 0) elapsed = 0;
+        if (elapsed > m->duration) elapsed = m->duration; // Resta all'arrivo finché la macchina a stati non lo ferma
+        int x = m->from_x + (int)((m->to_x - m->from_x) * elapsed / m->duration);
+        int y = m->from_y + (int)((m->to_y - m->from_y) * elapsed / m->duration);
+        fleet_set_position(moving[i], x, y);
+    }
+    // Il passo successivo serve solo se qualcuno è ancora in movimento
+    if (moving_count > 0) sim_schedule(&tick_timer, MOVEMENT_TICK_MS);
+    else ticking = 0;
+    mtx_unlock(&movement_mutex);
+}
+
+/**
+ * @brief Prepara i tratti di viaggio di tutti i soccorritori (indicizzati per ID del gemello digitale).
+ * @param count Numero totale di soccorritori.
+ */
+void movement_init(int count) {
+    mtx_init(&movement_mutex, mtx_plain);
+    sim_timer_init(&tick_timer, movement_tick, NULL);
+    motions = malloc((count > 0 ? count : 1) * sizeof(motion_t));
+    moving = malloc((count > 0 ? count : 1) * sizeof(int));
+    moving_slot = malloc((count > 0 ? count : 1) * sizeof(int));
+    CHECK_MALLOC(motions, fail);
+    CHECK_MALLOC(moving, fail);
+    CHECK_MALLOC(moving_slot, fail);
+    for (int i = 0; i < count; i++) {
+        moving_slot[i] = -1;
+    }
+    unit_count = count;
+    return;
+    fail:
+    unit_count = 0;
+}
+
+/**
+ * @brief Registra un tratto di viaggio di un soccorritore (sostituisce quello eventualmente in corso).
+ * @param id ID del gemello digitale.
+ * @param from_x Coordinata X di partenza.
+ * @param from_y Coordinata Y di partenza.
+ * @param to_x Coordinata X di arrivo.
+ * @param to_y Coordinata Y di arrivo.
+ * @param duration_ms Durata del viaggio in millisecondi di tempo virtuale.
+ */
+void movement_start(int id, int from_x, int from_y, int to_x, int to_y, sim_time_t duration_ms) {
+    if (id < 0 || id >= unit_count) return;
+    mtx_lock(&movement_mutex);
+    motions[id] = (motion_t){ .from_x = from_x, .from_y = from_y, .to_x = to_x, .to_y = to_y,
+        .start = sim_now(), .duration = duration_ms > 0 ? duration_ms : 1 };
+    fleet_set_position(id, from_x, from_y);
+    if (moving_slot[id] < 0) {
+        moving_slot[id] = moving_count;
+        moving[moving_count++] = id;
+    }
+    if (!ticking) {
+        ticking = 1;
+        sim_schedule(&tick_timer, MOVEMENT_TICK_MS);
+    }
+    mtx_unlock(&movement_mutex);
+}
+
+/**
+ * @brief Ferma un soccorritore in un punto (fine del viaggio, richiamo o posizione iniziale).
+ * @param id ID del gemello digitale.
+ * @param x Coordinata X.
+ * @param y Coordinata Y.
+ */
+void movement_stop(int id, int x, int y) {
+    if (id < 0 || id >= unit_count) return;
+    mtx_lock(&movement_mutex);
+    int slot = moving_slot[id];
+    if (slot >= 0) {
+        // Rimuove dall'array denso spostando l'ultimo al suo posto
+        int last = moving[--moving_count];
+        moving[slot] = last;
+        moving_slot[last] = slot;
+        moving_slot[id] = -1;
+    }
+    fleet_set_position(id, x, y);
+    mtx_unlock(&movement_mutex);
+}
@@ -1,6 +1,9 @@
 #include "mq_receiver.h"
 #include "types.h"
 #include "emergency_queue.h"
+#include "parser_emergency.h"
+#include "shm_ring.h"
+#include "emergency_pool.h"
 #include <mqueue.h>
 #include <string.h>
 #include <stdio.h>
@@ -10,121 +13,231 @@
 #include "logger.h"
 #include "macros.h"
 #include <threads.h>
+#include <poll.h>
+#include <errno.h>
 
 #define MAX_MSG_SIZE sizeof(emergency_request_t)
 
+// Capacità della message queue se quella configurata non è accettata dal sistema
+#define MQ_DEFAULT_DEPTH 10
+
+// Numero massimo di messaggi letti (e accodati) per ogni risveglio del ricevitore
+#define MQ_BATCH_MAX 64
+
 /**
  * @brief Struttura per passare gli argomenti al thread ricevitore della message queue.
  */
 struct mq_receiver_args {
-    emergency_type_t*   emergency_types;
-    int                 emergency_count;
-    env_config_t*       env_data;
+    emergency_type_index_t  type_index;     // Indice hash dei tipi di emergenza
+    env_config_t*           env_data;
 };
 
 /**
- * @brief Funzione eseguita dal thread ricevitore della message queue.
- * Riceve richieste di emergenza, valida i dati e le inserisce nella coda interna.
+ * @brief Apre (ricreandola) la message queue con la capacità configurata, in lettura non bloccante.
+ * Se il sistema rifiuta la capacità richiesta (es. oltre /proc/sys/fs/mqueue/msg_max) ripiega su MQ_DEFAULT_DEPTH.
+ */
+static mqd_t open_queue(const char* queue_name, int depth) {
+    struct mq_attr attr;
+    attr.mq_flags = 0;
+    attr.mq_maxmsg = depth > 0 ? depth : MQ_DEFAULT_DEPTH;
+    attr.mq_msgsize = sizeof(emergency_request_t);
+    attr.mq_curmsgs = 0;
+
+    mq_unlink(queue_name); // Rimuove la coda se esiste già
+    mqd_t mq = mq_open(queue_name, O_CREAT | O_RDONLY | O_NONBLOCK, 0644, &attr);
+    if (mq == (mqd_t)-1 && (errno == EINVAL || errno == EMFILE) && attr.mq_maxmsg != MQ_DEFAULT_DEPTH) {
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg), "Capacità della coda %ld non consentita (%s), uso %d", attr.mq_maxmsg, strerror(errno), MQ_DEFAULT_DEPTH);
+        log_event("1110", "MESSAGE_QUEUE", log_msg);
+        attr.mq_maxmsg = MQ_DEFAULT_DEPTH;
+        mq = mq_open(queue_name, O_CREAT | O_RDONLY | O_NONBLOCK, 0644, &attr);
+    }
+    return mq;
+}
+
+/**
+ * @brief Valida una richiesta e costruisce l'emergenza corrispondente.
+ * @return L'emergenza allocata, NULL se la richiesta non è valida o manca memoria.
+ */
+static emergency_t* build_emergency(emergency_request_t* req, emergency_type_index_t* type_index, env_config_t* env_data, int id) {
+    // Logga l'evento di ricezione; l'ora viene riformattata solo quando cambia il secondo
+    static time_t last_timestamp = (time_t)-1;
+    static char time_str[30];
+    if (req->timestamp != last_timestamp) {
+        struct tm tm_info;
+        localtime_r(&req->timestamp, &tm_info);
+        strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
+        last_timestamp = req->timestamp;
+    }
+    req->emergency_name[EMERGENCY_NAME_LENGTH - 1] = '\0';
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Ricevuta emergenza: %s luogo:(%d,%d) ora:%s", req->emergency_name, req->x, req->y, time_str);
+    log_event("0110", "MESSAGE_QUEUE", log_msg);
+
+    // Controlla se le coordinate sono valide
+    if (req->x < 0 || req->x >= env_data->width || req->y < 0 || req->y >= env_data->height) {
+        fprintf(stderr, "❌ Coordinate non valide: (%d,%d)\n", req->x, req->y);
+        // Logga l'errore di coordinate non valide
+        snprintf(log_msg, sizeof(log_msg), "Coordinate non valide: (%d,%d)", req->x, req->y);
+        log_event("1120", "MESSAGE_QUEUE", log_msg);
+        return NULL;
+    }
+
+    // Controlla se il tipo di emergenza è valido (lookup hash in tempo costante)
+    emergency_type_t* type = emergency_type_index_find(type_index, req->emergency_name);
+    if (!type) {
+        fprintf(stderr, "❌ Tipo di emergenza non riconosciuto: %s\n", req->emergency_name);
+        // Logga l'errore di tipo non riconosciuto
+        snprintf(log_msg, sizeof(log_msg), "Tipo di emergenza non riconosciuto: %s", req->emergency_name);
+        log_event("1120", "MESSAGE_QUEUE", log_msg);
+        return NULL;
+    }
+    // Logga il riconoscimento del tipo di emergenza
+    snprintf(log_msg, sizeof(log_msg), "Tipo di emergenza riconosciuto: %s", req->emergency_name);
+    log_event("0120", "MESSAGE_QUEUE", log_msg);
+
+    // Preleva dal pool e inizializza la struttura emergency_t
+    // (tipo, priorità e numero di soccorritori richiesti vengono dal tipo condiviso)
+    emergency_t* em = emergency_pool_get(type);
+    if (!em) return NULL;
+    em->x = (unsigned short)req->x;
+    em->y = (unsigned short)req->y;
+    em->id = id; // Assegna un ID univoco all'emergenza
+    return em;
+}
+
+/**
+ * @brief Inserisce nella coda interna un blocco di emergenze con una sola acquisizione del lock.
+ * Le emergenze rifiutate restano a carico del ricevitore e tornano al pool.
+ */
+static void enqueue_batch(emergency_t** batch, int n) {
+    int added = emergency_queue_add_batch(batch, n);
+    for (int i = added; i < n; i++) {
+        emergency_pool_put(batch[i]);
+    }
+}
+
+/**
+ * @brief Ciclo di ricezione dalla message queue POSIX.
+ * Attende che la coda abbia messaggi, poi li legge tutti in un colpo solo (coda non bloccante),
+ * li valida e inserisce le emergenze valide nella coda interna con una sola acquisizione del lock.
+ */
+static void receive_mq(mqd_t mq, emergency_type_index_t* type_index, env_config_t* env_data) {
+    emergency_request_t req;
+    emergency_t* batch[MQ_BATCH_MAX];
+    int id = 0;  // ID dell'emergenza
+    while (1) {
+        // Se la coda interna è piena smette di leggere: i messaggi restano nella
+        // message queue e i client vengono rallentati da mq_send
+        int space = emergency_queue_wait_space();
+        int limit = space < MQ_BATCH_MAX ? space : MQ_BATCH_MAX;
+
+        // Attende che arrivi almeno un messaggio (su Linux il descrittore della coda è un fd)
+        struct pollfd pfd = { .fd = (int)mq, .events = POLLIN };
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("❌ poll");
+            sleep(1);
+            continue;
+        }
+
+        // Svuota la coda fino al primo EAGAIN o al riempimento del blocco
+        int n = 0, received = 0;
+        while (n < limit) {
+            ssize_t bytes = mq_receive(mq, (char*)&req, MAX_MSG_SIZE, NULL);
+            if (bytes < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN) {
+                    perror("❌ mq_receive");
+                    sleep(1);
+                }
+                break;
+            }
+            received++;
+            emergency_t* em = build_emergency(&req, type_index, env_data, id);
+            if (!em) continue;
+            id++;
+            batch[n++] = em;
+        }
+        if (received > 0) printf("📨 [MQ] Ricevute %d emergenze (%d valide)\n", received, n);
+        if (n > 0) enqueue_batch(batch, n);
+    }
+}
+
+/**
+ * @brief Ciclo di ricezione dal ring in memoria condivisa.
+ * Le richieste vengono validate direttamente negli slot del ring, senza copiarle,
+ * e gli slot vengono restituiti ai client subito dopo.
+ */
+static void receive_shm(shm_ring_t* ring, emergency_type_index_t* type_index, env_config_t* env_data) {
+    emergency_t* batch[MQ_BATCH_MAX];
+    int id = 0;  // ID dell'emergenza
+    while (1) {
+        // Con la coda interna piena gli slot non vengono liberati e i client attendono in shm_ring_reserve
+        int space = emergency_queue_wait_space();
+        int limit = space < MQ_BATCH_MAX ? space : MQ_BATCH_MAX;
+
+        int n = 0, received = 0;
+        emergency_request_t* req;
+        while (n < limit && (req = shm_ring_peek(ring)) != NULL) {
+            received++;
+            emergency_t* em = build_emergency(req, type_index, env_data, id);
+            shm_ring_release(ring);
+            if (!em) continue;
+            id++;
+            batch[n++] = em;
+        }
+        if (received == 0) {
+            shm_ring_wait(ring); // Ring vuoto: dorme finché un client non pubblica
+            continue;
+        }
+        printf("📨 [SHM] Ricevute %d emergenze (%d valide)\n", received, n);
+        if (n > 0) enqueue_batch(batch, n);
+    }
+}
+
+/**
+ * @brief Funzione eseguita dal thread ricevitore.
+ * Apre il canale configurato (message queue POSIX o ring in memoria condivisa) e ne riceve le emergenze.
  * @param arg Puntatore a struct mq_receiver_args.
  * @return NULL.
  */
 int mq_receiver_thread(void* arg) {
-    mqd_t mq;
-    emergency_request_t req;
+    mqd_t mq = (mqd_t)-1;
 
     // Estrae gli argomenti passati al thread dalla struttura mq_receiver_args
     struct mq_receiver_args* args = (struct mq_receiver_args*)arg;
-    emergency_type_t* emergency_types = args->emergency_types; // Array dei tipi di emergenza
-    int emergency_count = args->emergency_count;               // Numero di tipi di emergenza
+    emergency_type_index_t type_index = args->type_index;     // Indice hash dei tipi di emergenza
     env_config_t* env_data = args->env_data;                   // Configurazione ambiente
     free(arg); // Libera la memoria allocata per gli argomenti
 
-    struct mq_attr attr;
-    attr.mq_flags = 0;
-    attr.mq_maxmsg = 10;  // massimo 10 messaggi in coda
-    attr.mq_msgsize = sizeof(emergency_request_t);
-    attr.mq_curmsgs = 0;
-
     // Prepara il nome della coda
     char* queue_name = malloc((strlen(env_data->queue) + 2) * sizeof(char));
     CHECK_MALLOC(queue_name, fail);
     snprintf(queue_name, strlen(env_data->queue) + 2, "/%s", env_data->queue);
 
-    mq_unlink(queue_name); // Rimuove la coda se esiste già
-    mq = mq_open(queue_name, O_CREAT | O_RDONLY, 0644, &attr);
-    CHECK_MQ_OPEN(mq, queue_name);
-    free(queue_name); // Libera la memoria allocata per il nome della coda
-
-    int id = 0;  // ID dell'emergenza
-    while (1) {
-        ssize_t bytes = mq_receive(mq, (char*)&req, MAX_MSG_SIZE, NULL);
-        if (bytes > 0) {
-            printf("📨 [MQ] Ricevuta emergenza: %s (%d,%d) %ld\n", req.emergency_name, req.x, req.y, req.timestamp);
-            
-            // Logga l'evento di ricezione
-            char buffer[30];
-            struct tm* tm_info = localtime(&req.timestamp);
-            strftime(buffer, sizeof(buffer), "%H:%M:%S", tm_info);
+    if (env_data->transport == TRANSPORT_SHM) {
+        shm_ring_t* ring = shm_ring_create(queue_name, env_data->queue_depth);
+        if (!ring) {
             char log_msg[256];
-            snprintf(log_msg, sizeof(log_msg), "Ricevuta emergenza: %s luogo:(%d,%d) ora:%s", req.emergency_name, req.x, req.y, buffer);
-            log_event("0110", "MESSAGE_QUEUE", log_msg);
-
-            // Controlla se le coordinate sono valide
-            if (req.x < 0 || req.x >= env_data->width || req.y < 0 || req.y >= env_data->height) {
-                fprintf(stderr, "❌ Coordinate non valide: (%d,%d)\n", req.x, req.y);
-                // Logga l'errore di coordinate non valide
-                char log_msg[256];
-                snprintf(log_msg, sizeof(log_msg), "Coordinate non valide: (%d,%d)", req.x, req.y);
-                log_event("1120", "MESSAGE_QUEUE", log_msg);
-                continue;
-            }
-
-            // Controlla se il tipo di emergenza è valido
-            int i =0;
-            for (i = 0; i < emergency_count; ++i) {
-                if (strcmp(req.emergency_name, emergency_types[i].emergency_desc) == 0) {
-                    break;
-                }
-            }
-            if (i == emergency_count) {
-                fprintf(stderr, "❌ Tipo di emergenza non riconosciuto: %s\n", req.emergency_name);
-                // Logga l'errore di tipo non riconosciuto
-                char log_msg[256];
-                snprintf(log_msg, sizeof(log_msg), "Tipo di emergenza non riconosciuto: %s", req.emergency_name);
-                log_event("1120", "MESSAGE_QUEUE", log_msg);
-                continue;
-            }else {
-                printf("📨 [MQ] ✅ Tipo di emergenza riconosciuto: %s\n", req.emergency_name);
-                // Logga il riconoscimento del tipo di emergenza
-                char log_msg[256];
-                snprintf(log_msg, sizeof(log_msg), "Tipo di emergenza riconosciuto: %s", req.emergency_name);
-                log_event("0120", "MESSAGE_QUEUE", log_msg);
-                // Alloca e inizializza la struttura emergency_t
-                emergency_t* em = malloc(sizeof(emergency_t));
-                CHECK_MALLOC(em, fail);
-                memset(em, 0, sizeof(emergency_t));
-                em->type = emergency_types[i];
-                em->x = req.x;
-                em->y = req.y;
-                em->status = WAITING;
-                // Calcola il numero totale di soccorritori richiesti
-                em->rescuer_count = 0;
-                for(int j = 0; j < emergency_types[i].rescuers_req_number; ++j) {
-                    em->rescuer_count += emergency_types[i].rescuers[j].required_count;
-                }
-                em->rescuers_dt = malloc(em->rescuer_count * sizeof(rescuer_digital_twin_t));
-                em->id = id++; // Assegna un ID univoco all'emergenza
-                mtx_init(&em->mutex, mtx_plain); // Inizializza il mutex
-                emergency_queue_add(em);    // Aggiunge l'emergenza alla coda interna
-            }
-
-        } else {
-            perror("❌ mq_receive");
-            sleep(1);
+            snprintf(log_msg, sizeof(log_msg), "Errore creando il ring condiviso %s: %s", queue_name, strerror(errno));
+            log_event("1110", "MESSAGE_QUEUE", log_msg);
+            fprintf(stderr, "❌ %s\n", log_msg);
+            free(queue_name);
+            return 0;
         }
+        free(queue_name);
+        printf("📨 [SHM] Ring condiviso pronto: %u slot\n", ring->capacity);
+        receive_shm(ring, &type_index, env_data);
+        shm_ring_close(ring);
+        return 0;
     }
 
-    
+    mq = open_queue(queue_name, env_data->queue_depth);
+    CHECK_MQ_OPEN(mq, queue_name);
+    free(queue_name); // Libera la memoria allocata per il nome della coda
+
+    receive_mq(mq, &type_index, env_data);
 
 fail:
     mq_close(mq);
@@ -142,8 +255,8 @@ void start_mq_receiver_thread(emergency_type_t emergency_types[], int emergency_
 
     struct mq_receiver_args* args = malloc(sizeof(struct mq_receiver_args));
     CHECK_MALLOC(args, fail);
-    args->emergency_types = emergency_types;
-    args->emergency_count = emergency_count;
+    // Costruisce una sola volta l'indice hash dei tipi di emergenza
+    if (emergency_type_index_build(&args->type_index, emergency_types, emergency_count) != 0) goto fail;
     args->env_data = env_data;
 
     printf("📨 [MQ] Avvio thread ricevitore coda: /%s\n", env_data->queue);
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "types.h"
+#include "parser_emergency.h"
 #include "logger.h"
 #include "macros.h"
 
@@ -9,8 +10,8 @@
 #define MAX_LINE_LENGTH 128
 // Numero massimo di richieste di soccorritori per tipo di emergenza
 #define MAX_RESCUERS_PER_TYPE 8
-// Numero massimo di tipi di emergenza gestibili
-#define MAX_EMERGENCY_TYPES 16
+// Capacità iniziale dell'array dei tipi di emergenza (cresce se necessario)
+#define INITIAL_EMERGENCY_TYPES 16
 
 /**
  * @brief Rimuove spazi iniziali e finali da una stringa.
@@ -112,6 +113,7 @@ int parse_emergency_type_line(
 
         // Alloca e popola la richiesta
         rescuer_request_t req;
+        req.type_id = rescuer_type_ptr->id;
         req.type = rescuer_type_ptr;
         req.required_count = required_count;
         req.time_to_manage = time_to_manage;
@@ -125,6 +127,10 @@ int parse_emergency_type_line(
     out_type->emergency_desc = strdup(emergency_name); // Copia la descrizione
     out_type->rescuers = rescuers; // Array di richieste
     out_type->rescuers_req_number = rescuer_count; // Numero di richieste
+    out_type->rescuers_total = 0;
+    for (int i = 0; i < rescuer_count; i++) {
+        out_type->rescuers_total += rescuers[i].required_count; // Soccorritori richiesti in totale
+    }
 
     return 0; // Successo
     fail:
@@ -152,16 +158,25 @@ int load_emergency_types(
     CHECK_FOPEN("1031",file, filename);
     log_event("0031", "FILE_PARSING", "File di configurazione aperto correttamente");
 
-    // Alloca spazio per un massimo di 16 tipi di emergenza
-    emergency_type_t* types = malloc(sizeof(emergency_type_t) * MAX_EMERGENCY_TYPES);
+    // Alloca spazio per i tipi di emergenza, raddoppiandolo quando si riempie
+    int capacity = INITIAL_EMERGENCY_TYPES;
+    emergency_type_t* types = malloc(sizeof(emergency_type_t) * capacity);
+    CHECK_MALLOC(types, fail);
     int count = 0;
     char line[MAX_LINE_LENGTH];
 
     // Legge il file riga per riga
     while (fgets(line, sizeof(line), file)) {
         if (strlen(trim(line)) == 0) continue; // Salta righe vuote
+        if (count == capacity) {
+            emergency_type_t* temp = realloc(types, sizeof(emergency_type_t) * capacity * 2);
+            CHECK_MALLOC(temp, fail);
+            types = temp;
+            capacity *= 2;
+        }
         // Parsea la riga e aggiunge la struttura risultante all'array
         if (parse_emergency_type_line(line, &types[count], known_types, known_types_count) == 0) {
+            types[count].id = count; // Assegna l'ID denso del tipo di emergenza
             count++;
             // Logga il caricamento corretto dell'emergenza
             char log_msg[256];
@@ -179,4 +194,93 @@ int load_emergency_types(
     *out_types = types; // Restituisce l'array di emergenze
     *out_count = count; // Restituisce il numero di emergenze caricate
     return 0; // Successo
+    fail:
+    if (file) fclose(file);
+    free(types);
+    return -1; // Errore: memoria insufficiente
+}
+
+/**
+ * @brief Calcola l'hash FNV-1a di una stringa.
+ * @param str Stringa terminata da '\0'.
+ * @return Hash a 32 bit.
+ */
+static unsigned int hash_name(const char* str) {
+    unsigned int h = 2166136261u;
+    while (*str) {
+        h ^= (unsigned char)*str++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Costruisce l'indice hash dei tipi di emergenza.
+ * La capacità è la prima potenza di 2 almeno doppia del numero di tipi, così
+ * le sequenze di probing restano corte anche con migliaia di tipi.
+ * In caso di nomi duplicati resta valido il primo tipo caricato.
+ * @param index Indice da popolare.
+ * @param types Array dei tipi di emergenza.
+ * @param count Numero di tipi di emergenza.
+ * @return 0 se la costruzione ha successo, -1 altrimenti.
+ */
+int emergency_type_index_build(emergency_type_index_t* index, emergency_type_t* types, int count) {
+    unsigned int capacity = 8;
+    while (capacity < (unsigned int)count * 2) capacity <<= 1;
+
+    index->types = types;
+    index->mask = capacity - 1;
+    index->hashes = malloc(capacity * sizeof(unsigned int));
+    index->slots = malloc(capacity * sizeof(int));
+    CHECK_MALLOC(index->hashes, fail);
+    CHECK_MALLOC(index->slots, fail);
+    for (unsigned int i = 0; i < capacity; i++) index->slots[i] = -1;
+
+    for (int i = 0; i < count; i++) {
+        unsigned int h = hash_name(types[i].emergency_desc);
+        unsigned int pos = h & index->mask;
+        int duplicate = 0;
+        // Probing lineare fino al primo slot libero
+        while (index->slots[pos] != -1) {
+            if (index->hashes[pos] == h && strcmp(types[index->slots[pos]].emergency_desc, types[i].emergency_desc) == 0) {
+                duplicate = 1;
+                break;
+            }
+            pos = (pos + 1) & index->mask;
+        }
+        if (duplicate) {
+            char log_msg[256];
+            snprintf(log_msg, sizeof(log_msg), "Emergenza duplicata ignorata: (%s)", types[i].emergency_desc);
+            log_event("1031", "FILE_PARSING", log_msg);
+            continue;
+        }
+        index->hashes[pos] = h;
+        index->slots[pos] = i;
+    }
+    return 0;
+    fail:
+    free(index->hashes);
+    free(index->slots);
+    index->hashes = NULL;
+    index->slots = NULL;
+    return -1;
+}
+
+/**
+ * @brief Cerca un tipo di emergenza per nome.
+ * Il confronto tra stringhe avviene solo quando l'hash coincide.
+ * @param index Indice costruito con emergency_type_index_build.
+ * @param name Nome dell'emergenza da cercare.
+ * @return Puntatore al tipo di emergenza, NULL se non esiste.
+ */
+emergency_type_t* emergency_type_index_find(const emergency_type_index_t* index, const char* name) {
+    if (!index->slots) return NULL;
+    unsigned int h = hash_name(name);
+    unsigned int pos = h & index->mask;
+    while (index->slots[pos] != -1) {
+        emergency_type_t* t = &index->types[index->slots[pos]];
+        if (index->hashes[pos] == h && strcmp(t->emergency_desc, name) == 0) return t;
+        pos = (pos + 1) & index->mask;
+    }
+    return NULL;
 }
\ No newline at end of file
@@ -33,6 +33,17 @@ int load_env_config(const char* filename, env_config_t* config) {
     CHECK_FOPEN("1011",file, filename);
     log_event("0011", "FILE_PARSING", "File di configurazione aperto correttamente");
 
+    // Valori di default dei parametri opzionali
+    config->queue_soft_limit = 0;
+    config->queue_hard_limit = 0;
+    config->queue_depth = 10;
+    config->transport = TRANSPORT_MQ;
+    config->return_to_base = 1;
+    // Di default la cache delle tabelle ETA sta accanto al file di configurazione
+    const char* slash = strrchr(filename, '/');
+    int dir_len = slash ? (int)(slash - filename) : 1;
+    snprintf(config->eta_cache_dir, MAX_CACHE_DIR, "%.*s/eta_cache", dir_len, slash ? filename : ".");
+
     char line[256];
     // Legge il file riga per riga
     while (fgets(line, sizeof(line), file)) {
@@ -61,6 +72,32 @@ int load_env_config(const char* filename, env_config_t* config) {
         } else if (strcmp(key, "width") == 0) {
             // Imposta la larghezza dell'ambiente
             config->width = atoi(value);
+        } else if (strcmp(key, "queue_soft_limit") == 0) {
+            // Imposta la soglia di congestione della coda delle emergenze
+            config->queue_soft_limit = atoi(value);
+        } else if (strcmp(key, "queue_hard_limit") == 0) {
+            // Imposta il numero massimo di emergenze in coda
+            config->queue_hard_limit = atoi(value);
+        } else if (strcmp(key, "queue_depth") == 0) {
+            // Imposta la capacità della message queue POSIX
+            config->queue_depth = atoi(value);
+        } else if (strcmp(key, "transport") == 0) {
+            // Imposta il canale di ingresso delle emergenze: "mq" o "shm"
+            if (strcmp(value, "mq") == 0) config->transport = TRANSPORT_MQ;
+            else if (strcmp(value, "shm") == 0) config->transport = TRANSPORT_SHM;
+            else {
+                char log_msg[256];
+                snprintf(log_msg, sizeof(log_msg), "Errore: transport non valido (%s)", value);
+                log_event("1011", "FILE_PARSING", log_msg);
+                return -1; // Errore: valore non valido
+            }
+        } else if (strcmp(key, "return_to_base") == 0) {
+            // Imposta se i soccorritori rientrano alla base a fine intervento (0 = restano sul posto)
+            config->return_to_base = atoi(value) != 0;
+        } else if (strcmp(key, "eta_cache_dir") == 0) {
+            // Imposta la directory dei file di cache delle tabelle ETA
+            strncpy(config->eta_cache_dir, value, MAX_CACHE_DIR-1);
+            config->eta_cache_dir[MAX_CACHE_DIR-1] = '\0';
         } else {
             // Chiave sconosciuta: logga l'errore e ritorna -1
             char log_msg[256];
@@ -75,5 +112,13 @@ int load_env_config(const char* filename, env_config_t* config) {
         log_event("0011", "FILE_PARSING", log_msg);
     }
     fclose(file); // Chiude il file
+
+    // Le coordinate delle emergenze sono memorizzate su 16 bit
+    if (config->width > EMERGENCY_COORD_MAX + 1 || config->height > EMERGENCY_COORD_MAX + 1) {
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg), "Errore: mappa troppo grande (%dx%d, massimo %d)", config->width, config->height, EMERGENCY_COORD_MAX + 1);
+        log_event("1011", "FILE_PARSING", log_msg);
+        return -1;
+    }
     return 0;
 }
\ No newline at end of file
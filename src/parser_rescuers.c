@@ -140,6 +140,7 @@ int load_rescuer_types(
     while (fgets(line, sizeof(line), file)) {
         if (strlen(trim(line)) == 0) continue; // Salta righe vuote
         if (parse_rescuer_type_line(line, &(*out_types)[count]) == 0) {
+            (*out_types)[count].rescuer_type.id = count; // Assegna l'ID denso del tipo
             count++;
         }
     }
@@ -1,12 +1,19 @@
 #include "types.h"
 #include <stdio.h>
-#include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include "logger.h"
 #include "emergency_status.h"
+#include "rescuer_pool.h"
+#include "sim_clock.h"
+#include "movement.h"
+#include "fleet.h"
+#include "eta_table.h"
 #include <threads.h>
 
+// 1 se i soccorritori rientrano alla base a fine intervento (env.conf: return_to_base)
+static int return_to_base = 1;
+
 /**
  * @brief Restituisce una stringa rappresentativa dello stato del soccorritore.
  * @param status Stato del soccorritore.
@@ -23,104 +30,338 @@ char* stato(rescuer_status_t status) {
 }
 
 /**
- * @brief Funzione eseguita dal thread del soccorritore.
- * Gestisce il ciclo di vita del soccorritore: attesa, viaggio, intervento e ritorno.
- * @param arg Puntatore a rescuer_thread_t.
- * @return NULL.
+ * @brief Arrivo sul luogo dell'emergenza: inizia l'intervento.
+ * @return Durata dell'intervento in secondi.
  */
-int rescuer_thread(void* arg) {
-    // Cast del parametro arg a un puntatore a struttura rescuer_thread_t
-    rescuer_thread_t* wrapper = (rescuer_thread_t*)arg; 
+static int arrive_on_scene(rescuer_thread_t* wrapper) {
     rescuer_digital_twin_t* r = wrapper->twin;
+    emergency_t* current_em = wrapper->current_em;
 
-    while (1) {
-        mtx_lock(&wrapper->mutex);
-        // Attende di essere assegnato a una nuova emergenza
-        while (r->status == IDLE) {
-            cnd_wait(&wrapper->cond, &wrapper->mutex);
-        }
-        mtx_unlock(&wrapper->mutex);
+    // Simula intervento: aggiorna posizione e stato, notifica l'inizio dell'intervento
+    r->x = current_em->x;
+    r->y = current_em->y;
+    movement_stop(r->id, r->x, r->y);
+    r->status = ON_SCENE;
+    update_emergency_status(current_em, IN_PROGRESS);
+    printf("🦺 [RESCUER] 🚨 [%s #%d] Intervento in corso a (%d,%d) in %d sec.\n",
+        r->rescuer->rescuer_type_name, r->id, r->x, r->y, wrapper->emergency_time);
 
-        emergency_t* current_em = wrapper->current_em;
+    log_record(&(log_record_t){ .kind = LOG_RESCUER_STATUS, .entity_id = r->id, .emergency_id = current_em->id,
+        .type_name = r->rescuer->rescuer_type_name, .status = r->status,
+        .x = r->x, .y = r->y, .duration = wrapper->emergency_time });
+    return wrapper->emergency_time;
+}
 
-        // Calcola il tempo di viaggio verso il luogo dell'emergenza (distanza Manhattan / velocità)
-        int travel_time = ( abs(r->x - current_em->x) + abs(r->y - current_em->y) ) / r->rescuer->speed;
-        if(travel_time == 0) travel_time = 1; // per evitare viaggi istantanei
+/**
+ * @brief Avvia il rientro alla base dalla posizione del gemello (stato già RETURNING_TO_BASE, mutex acquisito).
+ * Il timer del rientro lo programma il chiamante con wrapper->return_time.
+ * @param em_id ID dell'emergenza lasciata (per il log).
+ * @return Durata del viaggio di ritorno in secondi.
+ */
+static int start_return(rescuer_thread_t* wrapper, int em_id) {
+    rescuer_digital_twin_t* r = wrapper->twin;
+    // Tempo di rientro dal punto attuale alla base (la tabella vale in entrambi i versi)
+    int travel_time = eta_table_lookup(r->rescuer->id, r->x, r->y);
+    if (travel_time < 0) travel_time = ( abs(r->x - r->rescuer->x) + abs(r->y - r->rescuer->y) ) / r->rescuer->speed;
+    if(travel_time == 0) travel_time = 1; // per evitare viaggi istantanei
+    wrapper->return_time = travel_time;
+    movement_start(r->id, r->x, r->y, r->rescuer->x, r->rescuer->y, (sim_time_t)travel_time * 1000);
 
-        // Trova l'indice della richiesta di soccorritore corrispondente al tipo
-        int index = -1;
-        for (int i = 0; i < current_em->type.rescuers_req_number; i++) {
-            if (strcmp(current_em->type.rescuers[i].type->rescuer_type_name,
-                    r->rescuer->rescuer_type_name) == 0) {
-                index = i;
-                break;
-            }
-        }
-        // Tempo di intervento specifico per il tipo di soccorritore
-        int emergency_time = current_em->type.rescuers[index].time_to_manage;
-
-        mtx_lock(&wrapper->mutex);
-        // Aggiorna stato: partenza verso il luogo dell'emergenza
-        r->status = EN_ROUTE_TO_SCENE;
-        printf("🦺 [RESCUER] 🚀 [(%s) (%s)] Partenza verso il luogo dell'emergenza (%d,%d) -> (%d,%d) in %d sec.\n",
-            r->rescuer->rescuer_type_name, stato(r->status), current_em->x, current_em->y, r->x, r->y, travel_time);
-        char log_msg[256];
-        snprintf(log_msg, sizeof(log_msg), "[(%s) (%s) (%d,%d) (%d)] Partenza verso il luogo dell'emergenza (%d,%d) -> (%d,%d) in %d sec.",
-            r->rescuer->rescuer_type_name, stato(r->status), current_em->x, current_em->y, travel_time, r->x, r->y, current_em->x, current_em->y,travel_time);
-        char id [5];
-        snprintf(id, sizeof(id), "0%03d", r->id);
-        log_event(id, "RESCUER_STATUS", log_msg);
-        sleep(travel_time); // Simula il tempo di viaggio
-
-        // Simula intervento: aggiorna posizione e stato, notifica l'inizio dell'intervento
-        r->x = current_em->x;
-        r->y = current_em->y;
-        r->status = ON_SCENE;
-        update_emergency_status(current_em, IN_PROGRESS);
-        printf("🦺 [RESCUER] 🚨 [%s #%d] Intervento in corso a (%d,%d) in %d sec.\n",
-            r->rescuer->rescuer_type_name, r->id, r->x, r->y, emergency_time);
-
-        snprintf(log_msg, sizeof(log_msg), "[(%s) (%s) (%d,%d) (%d)] Intervento in corso a (%d,%d) in %d sec.",
-            r->rescuer->rescuer_type_name, stato(r->status), r->x, r->y , emergency_time, r->x, r->y, emergency_time);
-        snprintf(id, sizeof(id), "0%03d", r->id);
-        log_event(id, "RESCUER_STATUS", log_msg);
-        sleep(emergency_time); // Simula il tempo di intervento        
-
-        //Riritorno alla base
-        r->x = r->rescuer->x;
-        r->y = r->rescuer->y;
-        r->status = RETURNING_TO_BASE;
-
-        printf("🦺 [RESCUER] 🏡 [%s #%d] Rientrato alla base (%d,%d) -> (%d,%d) in %d sec.\n",
-            r->rescuer->rescuer_type_name, r->id,current_em->x, current_em->y, r->x, r->y, travel_time);
-        snprintf(log_msg, sizeof(log_msg), "[(%s) (%s) (%d,%d) (%d)] Rientrato alla base (%d,%d) -> (%d,%d) in %d sec.",
-            r->rescuer->rescuer_type_name, stato(r->status), r->x, r->y, travel_time ,current_em->x, current_em->y, r->x, r->y, travel_time);
-        snprintf(id, sizeof(id), "0%03d", r->id);
-        update_emergency_status(current_em, COMPLETED);
-        wrapper->current_em = NULL;
-
-        log_event(id, "RESCUER_STATUS", log_msg);
-        sleep(travel_time); // Simula il tempo di viaggio di ritorno
-        
-        // Completa e torna IDLE
+    printf("🦺 [RESCUER] 🏡 [%s #%d] In rientro verso la base (%d,%d) -> (%d,%d) in %d sec.\n",
+        r->rescuer->rescuer_type_name, r->id, r->x, r->y, r->rescuer->x, r->rescuer->y, travel_time);
+    log_record(&(log_record_t){ .kind = LOG_RESCUER_STATUS, .entity_id = r->id, .emergency_id = em_id,
+        .type_name = r->rescuer->rescuer_type_name, .status = r->status, .x = r->x, .y = r->y,
+        .from_x = r->x, .from_y = r->y, .to_x = r->rescuer->x, .to_y = r->rescuer->y, .duration = travel_time });
+    return travel_time;
+}
+
+/**
+ * @brief Fine dell'intervento: chiude la propria parte dell'emergenza e rientra alla base (se previsto).
+ * La posizione del gemello resta quella della scena: durante il rientro quella attuale la avanza il motore di movimento.
+ * @return Durata del viaggio di ritorno in secondi (-1 se resta libero sul posto).
+ */
+static int leave_scene(rescuer_thread_t* wrapper) {
+    rescuer_digital_twin_t* r = wrapper->twin;
+    emergency_t* current_em = wrapper->current_em;
+    int em_id = current_em->id;
+
+    // Passa in RETURNING_TO_BASE e, se era l'ultimo soccorritore impegnato, completa l'emergenza
+    release_emergency_rescuer(current_em, r);
+    wrapper->current_em = NULL;
+
+    if (!return_to_base) {
+        // Resta libero sul luogo dell'intervento
         r->status = IDLE;
-        printf("🦺 [RESCUER] ✅ [%s #%d] Intervento completato.\n", r->rescuer->rescuer_type_name, r->id);
-        snprintf(log_msg, sizeof(log_msg), "[(%s) (%s)] Intervento completato.", r->rescuer->rescuer_type_name, stato(r->status));
-        snprintf(id, sizeof(id), "0%03d", r->id);
-        log_event(id, "RESCUER_STATUS", log_msg);
+        printf("🦺 [RESCUER] ✅ [%s #%d] Intervento completato, resta libero in (%d,%d).\n",
+            r->rescuer->rescuer_type_name, r->id, r->x, r->y);
+        log_record(&(log_record_t){ .kind = LOG_RESCUER_STATUS, .entity_id = r->id,
+            .type_name = r->rescuer->rescuer_type_name, .status = r->status });
+        return -1;
+    }
+    return start_return(wrapper, em_id);
+}
+
+/**
+ * @brief Rientro alla base completato: il soccorritore torna IDLE.
+ * Durante il rientro era già nel pool (nella posizione di partenza): ora viene spostato alla base.
+ */
+static void back_to_base(rescuer_thread_t* wrapper) {
+    rescuer_digital_twin_t* r = wrapper->twin;
+    // Completa e torna IDLE alla base
+    r->x = r->rescuer->x;
+    r->y = r->rescuer->y;
+    movement_stop(r->id, r->x, r->y);
+    r->status = IDLE;
+    printf("🦺 [RESCUER] ✅ [%s #%d] Intervento completato.\n", r->rescuer->rescuer_type_name, r->id);
+    log_record(&(log_record_t){ .kind = LOG_RESCUER_STATUS, .entity_id = r->id,
+        .type_name = r->rescuer->rescuer_type_name, .status = r->status });
+    rescuer_pool_relocate(wrapper);
+}
+
+/**
+ * @brief Callback del timer del soccorritore, eseguita da un worker del motore ad eventi.
+ * Fa avanzare la macchina a stati EN_ROUTE_TO_SCENE → ON_SCENE → RETURNING_TO_BASE → IDLE
+ * e programma la scadenza della fase successiva.
+ * @param arg Puntatore a rescuer_thread_t.
+ */
+static void rescuer_step(void* arg) {
+    rescuer_thread_t* wrapper = (rescuer_thread_t*)arg;
+    int next_phase = -1; // Durata della prossima fase in secondi (-1 = nessuna)
+
+    mtx_lock(&wrapper->mutex);
+    if (wrapper->stale_step) {
+        // Rientro interrotto da una nuova partenza quando il timer era già scaduto
+        wrapper->stale_step = 0;
         mtx_unlock(&wrapper->mutex);
-        
+        return;
     }
+    switch (wrapper->twin->status) {
+    case EN_ROUTE_TO_SCENE:
+        next_phase = arrive_on_scene(wrapper);
+        break;
+    case ON_SCENE:
+        // Il soccorritore torna subito assegnabile, anche durante il rientro. Il rientro viene
+        // programmato prima di rimetterlo nel pool e sotto il suo mutex: né la fine del rientro
+        // né una nuova partenza possono precederlo
+        if (leave_scene(wrapper) >= 0) {
+            sim_schedule(&wrapper->timer, (sim_time_t)wrapper->return_time * 1000);
+        }
+        rescuer_pool_put(wrapper);
+        break;
+    case RETURNING_TO_BASE:
+        back_to_base(wrapper);
+        break;
+    default:
+        break;
+    }
+    fleet_set_state(wrapper->twin->id, wrapper->twin->status, wrapper->current_em, wrapper->slot); // Pubblica la transizione
+    mtx_unlock(&wrapper->mutex);
 
-    return 0;
+    if (next_phase >= 0) {
+        sim_schedule(&wrapper->timer, (sim_time_t)next_phase * 1000);
+    }
+}
+
+/**
+ * @brief Posizione attuale di un soccorritore, letta dagli array della flotta senza acquisire il suo mutex.
+ * @param wrapper Soccorritore.
+ * @param x Restituisce la coordinata X.
+ * @param y Restituisce la coordinata Y.
+ */
+void rescuer_position(const rescuer_thread_t* wrapper, int* x, int* y) {
+    fleet_position(wrapper->twin->id, x, y);
+}
+
+/**
+ * @brief Imposta il comportamento dei soccorritori a fine intervento.
+ * @param enabled 1 se rientrano alla base, 0 se restano liberi sul luogo dell'intervento.
+ */
+void rescuer_set_return_to_base(int enabled) {
+    return_to_base = enabled;
+}
+
+/**
+ * @brief Indica se i soccorritori rientrano alla base a fine intervento.
+ */
+int rescuer_returns_to_base(void) {
+    return return_to_base;
 }
 
 /**
- * @brief Inizializza e avvia il thread del soccorritore.
- * @param rescuer_wrapped Puntatore a rescuer_thread_t da avviare.
+ * @brief Invia un soccorritore (già prelevato dal pool) verso un'emergenza.
+ * Calcola i tempi di viaggio e di intervento e programma l'arrivo sul posto.
+ * @param wrapper Soccorritore da inviare.
+ * @param current_em Emergenza da gestire.
+ * @param slot Posto del soccorritore nella squadra dell'emergenza.
+ */
+void rescuer_dispatch(rescuer_thread_t* wrapper, emergency_t* current_em, int slot) {
+    rescuer_digital_twin_t* r = wrapper->twin;
+
+    mtx_lock(&wrapper->mutex);
+    wrapper->current_em = current_em;
+    wrapper->slot = slot;
+
+    if (r->status == RETURNING_TO_BASE) {
+        // Rientro interrotto: parte direttamente dal punto raggiunto verso la nuova emergenza
+        fleet_position(r->id, &r->x, &r->y);
+        if (sim_cancel(&wrapper->timer) != 0) wrapper->stale_step = 1; // Il timer del rientro è già scaduto
+        printf("🦺 [RESCUER] 🔀 [%s #%d] Rientro interrotto in (%d,%d) per una nuova emergenza.\n",
+            r->rescuer->rescuer_type_name, r->id, r->x, r->y);
+    }
+
+    // Calcola il tempo di viaggio verso il luogo dell'emergenza (distanza Manhattan / velocità),
+    // precalcolato nella tabella del tipo se il soccorritore parte dalla base
+    int travel_time = -1;
+    if (r->x == r->rescuer->x && r->y == r->rescuer->y) travel_time = eta_table_lookup(r->rescuer->id, current_em->x, current_em->y);
+    if (travel_time < 0) travel_time = ( abs(r->x - current_em->x) + abs(r->y - current_em->y) ) / r->rescuer->speed;
+    if(travel_time == 0) travel_time = 1; // per evitare viaggi istantanei
+
+    // Trova la richiesta a cui appartiene il posto (i posti seguono l'ordine delle richieste)
+    int index = -1;
+    for (int i = 0, first = 0; i < current_em->type->rescuers_req_number; i++) {
+        first += current_em->type->rescuers[i].required_count;
+        if (slot < first) {
+            index = i;
+            break;
+        }
+    }
+    // Tempo di intervento specifico per il tipo di soccorritore, meno quello già svolto nel posto prima di una sospensione
+    wrapper->travel_time = travel_time;
+    wrapper->emergency_time = index >= 0 ? current_em->type->rescuers[index].time_to_manage - current_em->slots[slot].work_done : 0;
+    if (wrapper->emergency_time < 0) wrapper->emergency_time = 0;
+
+    // Aggiorna stato: partenza verso il luogo dell'emergenza
+    r->status = EN_ROUTE_TO_SCENE;
+    fleet_set_state(r->id, r->status, current_em, slot);
+    movement_start(r->id, r->x, r->y, current_em->x, current_em->y, (sim_time_t)travel_time * 1000);
+    printf("🦺 [RESCUER] 🚀 [(%s) (%s)] Partenza verso il luogo dell'emergenza (%d,%d) -> (%d,%d) in %d sec.\n",
+        r->rescuer->rescuer_type_name, stato(r->status), current_em->x, current_em->y, r->x, r->y, travel_time);
+    log_record(&(log_record_t){ .kind = LOG_RESCUER_STATUS, .entity_id = r->id, .emergency_id = current_em->id,
+        .type_name = r->rescuer->rescuer_type_name, .status = r->status,
+        .x = current_em->x, .y = current_em->y, .from_x = r->x, .from_y = r->y,
+        .to_x = current_em->x, .to_y = current_em->y, .duration = travel_time });
+    mtx_unlock(&wrapper->mutex);
+
+    sim_schedule(&wrapper->timer, (sim_time_t)travel_time * 1000); // Simula il tempo di viaggio
+}
+
+/**
+ * @brief Inizializza lo stato di runtime del soccorritore.
+ * Non viene creato alcun thread: le transizioni di stato sono callback eseguite
+ * dal pool di worker del motore ad eventi.
+ * @param rescuer_wrapped Puntatore a rescuer_thread_t da inizializzare.
  */
 void start_rescuer(rescuer_thread_t* rescuer_wrapped) {
     mtx_init(&rescuer_wrapped->mutex, mtx_plain);
-    cnd_init(&rescuer_wrapped->cond);
-    thrd_create(&rescuer_wrapped->thread, rescuer_thread, rescuer_wrapped);
+    rescuer_wrapped->return_time = 0;
+    rescuer_wrapped->stale_step = 0;
+    sim_timer_init(&rescuer_wrapped->timer, rescuer_step, rescuer_wrapped);
+}
+
+/**
+ * @brief Prepara il richiamo di tutti i soccorritori impegnati su un'emergenza in corso (prelazione).
+ *
+ * I soccorritori vengono bloccati tutti insieme (stesso ordine di acquisizione dei lock della
+ * macchina a stati: soccorritore, poi emergenza) e i loro timer annullati. Se uno di loro sta
+ * già cambiando fase, o l'emergenza non è più sospendibile con esattamente questi soccorritori,
+ * i timer vengono riprogrammati con il tempo residuo e non cambia nulla. Altrimenti i soccorritori
+ * restano bloccati, fermi, finché rescuer_preempt_commit o rescuer_preempt_abort non li rilasciano.
+ *
+ * @param em Emergenza IN_PROGRESS da sospendere.
+ * @param em_id ID atteso dell'emergenza (il record potrebbe essere stato riciclato per un'altra emergenza).
+ * @param units Soccorritori impegnati sull'emergenza (in viaggio o sulla scena).
+ * @param n Numero di soccorritori.
+ * @param remaining Restituisce, per ogni soccorritore, il tempo residuo (ms) della fase interrotta.
+ * @return 0 se il richiamo è pronto (soccorritori bloccati), -1 altrimenti (nessuna modifica).
+ */
+int rescuer_preempt_prepare(emergency_t* em, int em_id, rescuer_thread_t** units, int n, sim_time_t* remaining) {
+    int locked = 0, cancelled = 0;
+
+    for (; locked < n; locked++) {
+        mtx_lock(&units[locked]->mutex);
+    }
+    for (; cancelled < n; cancelled++) {
+        rescuer_thread_t* w = units[cancelled];
+        rescuer_status_t status = w->twin->status;
+        // Con il soccorritore ancora impegnato su em il record è vivo e il suo ID si può leggere
+        if (w->current_em != em || em->id != em_id || (status != EN_ROUTE_TO_SCENE && status != ON_SCENE)) break;
+        if (sim_cancel_remaining(&w->timer, &remaining[cancelled]) != 0) break; // Sta cambiando fase
+    }
+    if (cancelled < n || !emergency_pausable(em, n)) {
+        // Annulla il richiamo: ogni soccorritore riprende la fase interrotta
+        for (int j = 0; j < cancelled; j++) {
+            sim_schedule(&units[j]->timer, remaining[j]);
+        }
+        for (int j = 0; j < locked; j++) mtx_unlock(&units[j]->mutex);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Annulla un richiamo preparato: ogni soccorritore riprende la fase interrotta e viene sbloccato.
+ * @param units Soccorritori passati a rescuer_preempt_prepare.
+ * @param n Numero di soccorritori.
+ * @param remaining Tempi residui restituiti da rescuer_preempt_prepare.
+ */
+void rescuer_preempt_abort(rescuer_thread_t** units, int n, const sim_time_t* remaining) {
+    for (int j = 0; j < n; j++) {
+        sim_schedule(&units[j]->timer, remaining[j]);
+        mtx_unlock(&units[j]->mutex);
+    }
+}
+
+/**
+ * @brief Completa un richiamo preparato: sospende l'emergenza e libera i soccorritori.
+ *
+ * L'intervento svolto da ognuno viene accreditato al suo posto nella squadra e i soccorritori si
+ * liberano come a fine intervento: rientrano alla base dalla scena o dal punto raggiunto in viaggio
+ * (o, senza rientro, restano liberi dove si trovano), e tornano subito nel pool del loro tipo.
+ *
+ * @param em Emergenza da sospendere.
+ * @param em_id ID dell'emergenza.
+ * @param units Soccorritori passati a rescuer_preempt_prepare.
+ * @param n Numero di soccorritori.
+ * @param remaining Tempi residui restituiti da rescuer_preempt_prepare.
+ * @param work_done Restituisce i secondi di intervento svolti dall'ultima ripresa (il massimo tra i posti).
+ */
+void rescuer_preempt_commit(emergency_t* em, int em_id, rescuer_thread_t** units, int n, const sim_time_t* remaining, int* work_done) {
+    int slots[n > 0 ? n : 1];
+    int done[n > 0 ? n : 1];
+    int done_max = 0;
+    for (int j = 0; j < n; j++) {
+        slots[j] = units[j]->slot;
+        done[j] = units[j]->twin->status == ON_SCENE ? (units[j]->emergency_time * 1000 - (int)remaining[j]) / 1000 : 0;
+        if (done[j] > done_max) done_max = done[j];
+    }
+    // Già verificata da rescuer_preempt_prepare: con i soccorritori bloccati non può fallire
+    pause_emergency(em, n, slots, done);
+
+    for (int j = 0; j < n; j++) {
+        rescuer_digital_twin_t* r = units[j]->twin;
+        units[j]->current_em = NULL;
+        if (r->status == EN_ROUTE_TO_SCENE) {
+            // Il viaggio si interrompe nel punto raggiunto
+            fleet_position(r->id, &r->x, &r->y);
+            movement_stop(r->id, r->x, r->y);
+        }
+        printf("🦺 [RESCUER] ↩️ [%s #%d] Richiamato in (%d,%d) per un'emergenza più urgente.\n",
+            r->rescuer->rescuer_type_name, r->id, r->x, r->y);
+        if (return_to_base) {
+            // Rientra alla base come a fine intervento
+            r->status = RETURNING_TO_BASE;
+            start_return(units[j], em_id);
+            sim_schedule(&units[j]->timer, (sim_time_t)units[j]->return_time * 1000);
+        } else {
+            r->status = IDLE;
+            log_record(&(log_record_t){ .kind = LOG_RESCUER_STATUS, .entity_id = r->id,
+                .type_name = r->rescuer->rescuer_type_name, .status = r->status });
+        }
+        fleet_set_state(r->id, r->status, NULL, -1);
+        // Di nuovo disponibile, anche durante il rientro: come in rescuer_step torna nel pool sotto il
+        // suo mutex, così la fine del rientro non può precederlo
+        rescuer_pool_put(units[j]);
+        mtx_unlock(&units[j]->mutex);
+    }
+    *work_done = done_max;
 }
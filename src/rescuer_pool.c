@@ -0,0 +1,378 @@
+#include "rescuer_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "logger.h"
+#include "macros.h"
+#include "waitlist.h"
+#include "fleet.h"
+#include <threads.h>
+
+// Lato (in unità di mappa) di una cella della griglia spaziale
+#define GRID_CELL_SIZE 16
+
+/**
+ * @brief Punto della mappa in cui si trovano uno o più soccorritori liberi dello stesso tipo.
+ * Raggruppare i soccorritori per posizione esatta evita di scorrerli uno a uno quando
+ * sono tutti fermi nello stesso punto (tipicamente la base).
+ */
+typedef struct idle_spot {
+    int x;                          // Coordinata X del punto
+    int y;                          // Coordinata Y del punto
+    rescuer_thread_t* head;         // Soccorritori liberi in questo punto (lista intrusiva doppia)
+    int count;                      // Numero di soccorritori liberi in questo punto
+    struct idle_spot* next;         // Spot successivo nella stessa cella (o nella free list)
+    struct idle_spot* prev;         // Spot precedente nella stessa cella
+} idle_spot_t;
+
+/**
+ * @brief Candidato valutato durante la ricerca dei soccorritori più vicini.
+ */
+typedef struct {
+    idle_spot_t* spot;              // Spot candidato
+    rescuer_thread_t* unit;         // Soccorritore in rientro (NULL se il candidato è uno spot fermo)
+    int distance;                   // Distanza di Manhattan dal candidato all'emergenza
+} spot_candidate_t;
+
+/**
+ * @brief Pool dei soccorritori liberi di un singolo tipo.
+ * I soccorritori liberi sono indicizzati in una griglia uniforme che copre la mappa:
+ * ogni cella contiene gli spot (posizioni esatte) dei soccorritori che vi si trovano.
+ * Quelli in rientro alla base si muovono: stanno in uno spot a parte, fuori dalla griglia,
+ * e la loro posizione viene letta dagli array della flotta a ogni ricerca.
+ */
+typedef struct {
+    const rescuer_type_t* type;     // Tipo di soccorritore gestito dal pool
+    idle_spot_t** cells;            // Griglia di celle (grid_w * grid_h liste di spot)
+    idle_spot_t* free_spots;        // Spot non utilizzati, riciclati invece di liberarli
+    idle_spot_t moving;             // Soccorritori liberi in rientro alla base (fuori dalla griglia)
+    spot_candidate_t* candidates;   // Buffer riutilizzato per la ricerca dei più vicini
+    int candidates_size;            // Capacità del buffer dei candidati
+    int idle_count;                 // Numero di soccorritori liberi nel pool
+    mtx_t mutex;                    // Mutex del pool
+} rescuer_pool_t;
+
+// Un pool per ogni tipo di soccorritore
+static rescuer_pool_t* pools = NULL;
+static int pool_count = 0;
+
+// Dimensioni della griglia in celle
+static int grid_w = 1;
+static int grid_h = 1;
+
+/**
+ * @brief Inizializza un pool (vuoto) di soccorritori liberi per ogni tipo di soccorritore.
+ * @param types Array dei tipi di soccorritore caricati da file.
+ * @param type_count Numero di tipi di soccorritore.
+ * @param width Larghezza della mappa.
+ * @param height Altezza della mappa.
+ */
+void rescuer_pool_init(rescuer_type_info_t* types, int type_count, int width, int height) {
+    grid_w = width / GRID_CELL_SIZE + 1;
+    grid_h = height / GRID_CELL_SIZE + 1;
+    pools = malloc(type_count * sizeof(rescuer_pool_t));
+    CHECK_MALLOC(pools, fail);
+    for (int i = 0; i < type_count; i++) {
+        pools[i].type = &types[i].rescuer_type; // types[i].rescuer_type.id == i
+        pools[i].cells = calloc(grid_w * grid_h, sizeof(idle_spot_t*));
+        CHECK_MALLOC(pools[i].cells, fail);
+        pools[i].free_spots = NULL;
+        pools[i].moving = (idle_spot_t){ 0 };
+        pools[i].candidates = NULL;
+        pools[i].candidates_size = 0;
+        pools[i].idle_count = 0;
+        mtx_init(&pools[i].mutex, mtx_plain);
+    }
+    pool_count = type_count;
+    return;
+    fail:
+    pool_count = 0;
+}
+
+/**
+ * @brief Calcola la cella della griglia che contiene un punto (i punti fuori mappa vanno sul bordo).
+ */
+static int cell_coord(int v, int cells) {
+    int c = v / GRID_CELL_SIZE;
+    if (c < 0) return 0;
+    if (c >= cells) return cells - 1;
+    return c;
+}
+
+/**
+ * @brief Inserisce un soccorritore nello spot della sua posizione attuale (con mutex del pool già acquisito).
+ * I soccorritori in rientro alla base vanno nello spot dei soccorritori in movimento.
+ * @return 0 se inserito, -1 se l'allocazione dello spot fallisce.
+ */
+static int pool_link(rescuer_pool_t* pool, rescuer_thread_t* r) {
+    int x = r->twin->x;
+    int y = r->twin->y;
+    idle_spot_t** cell = &pool->cells[cell_coord(y, grid_h) * grid_w + cell_coord(x, grid_w)];
+
+    // Cerca lo spot della posizione esatta nella cella (di solito sono pochi)
+    idle_spot_t* spot = *cell;
+    if (r->twin->status == RETURNING_TO_BASE) spot = &pool->moving;
+    else while (spot && (spot->x != x || spot->y != y)) spot = spot->next;
+    if (!spot) {
+        // Nuovo spot: preferisce uno spot riciclato
+        if (pool->free_spots) {
+            spot = pool->free_spots;
+            pool->free_spots = spot->next;
+        } else {
+            spot = malloc(sizeof(idle_spot_t));
+            CHECK_MALLOC(spot, fail);
+        }
+        spot->x = x;
+        spot->y = y;
+        spot->head = NULL;
+        spot->count = 0;
+        spot->prev = NULL;
+        spot->next = *cell;
+        if (*cell) (*cell)->prev = spot;
+        *cell = spot;
+    }
+    // Inserisce il soccorritore in testa alla lista dello spot
+    r->idle_spot = spot;
+    r->prev_idle = NULL;
+    r->next_idle = spot->head;
+    if (spot->head) spot->head->prev_idle = r;
+    spot->head = r;
+    spot->count++;
+    pool->idle_count++;
+    return 0;
+    fail:
+    return -1;
+}
+
+/**
+ * @brief Inserisce un soccorritore libero (IDLE o in rientro alla base) nel pool del suo tipo,
+ * nella cella della sua posizione attuale.
+ * @param r Soccorritore tornato disponibile.
+ */
+void rescuer_pool_put(rescuer_thread_t* r) {
+    int type_id = r->twin->rescuer->id;
+    if (type_id < 0 || type_id >= pool_count) {
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg), "Tipo di soccorritore sconosciuto: %s", r->twin->rescuer->rescuer_type_name);
+        char id [5];
+        snprintf(id, sizeof(id), "1%03d", r->twin->id);
+        log_rescuer_event(r->twin->id, id, "RESCUER_POOL", log_msg);
+        return;
+    }
+    rescuer_pool_t* pool = &pools[type_id]; // Il pool è indicizzato direttamente dall'ID del tipo
+
+    mtx_lock(&pool->mutex);
+    int ok = pool_link(pool, r) == 0;
+    int idle_count = pool->idle_count;
+    mtx_unlock(&pool->mutex);
+    // Le emergenze in attesa di questo tipo possono ora essere servite
+    if (ok) waitlist_notify(type_id, idle_count);
+}
+
+/**
+ * @brief Stacca un soccorritore dal suo spot; se lo spot si svuota lo ricicla (con mutex già acquisito).
+ */
+static void pool_unlink(rescuer_pool_t* pool, rescuer_thread_t* r) {
+    idle_spot_t* spot = r->idle_spot;
+    if (r->prev_idle) r->prev_idle->next_idle = r->next_idle;
+    else spot->head = r->next_idle;
+    if (r->next_idle) r->next_idle->prev_idle = r->prev_idle;
+    r->next_idle = r->prev_idle = NULL;
+    r->idle_spot = NULL;
+    spot->count--;
+    pool->idle_count--;
+
+    if (spot->count == 0 && spot != &pool->moving) {
+        // Rimuove lo spot vuoto dalla sua cella e lo mette nella free list
+        if (spot->prev) spot->prev->next = spot->next;
+        else pool->cells[cell_coord(spot->y, grid_h) * grid_w + cell_coord(spot->x, grid_w)] = spot->next;
+        if (spot->next) spot->next->prev = spot->prev;
+        spot->next = pool->free_spots;
+        pool->free_spots = spot;
+    }
+}
+
+/**
+ * @brief Sposta nella sua posizione attuale un soccorritore che ha cambiato posizione restando libero
+ * (anche dallo spot dei soccorritori in movimento alla griglia, a rientro completato).
+ * Se nel frattempo è stato prelevato dallo scheduler non fa nulla.
+ * @param r Soccorritore rientrato alla base.
+ */
+void rescuer_pool_relocate(rescuer_thread_t* r) {
+    int type_id = r->twin->rescuer->id;
+    if (type_id < 0 || type_id >= pool_count) return;
+    rescuer_pool_t* pool = &pools[type_id];
+    mtx_lock(&pool->mutex);
+    if (r->idle_spot && (r->idle_spot == &pool->moving
+                         || r->idle_spot->x != r->twin->x || r->idle_spot->y != r->twin->y)) {
+        pool_unlink(pool, r);
+        pool_link(pool, r);
+    }
+    mtx_unlock(&pool->mutex);
+}
+
+/**
+ * @brief Garantisce nel buffer dei candidati spazio per un candidato oltre i found già presenti.
+ * @return 0 se c'è spazio, -1 se l'allocazione fallisce.
+ */
+static int grow_candidates(rescuer_pool_t* pool, int found) {
+    if (found < pool->candidates_size) return 0;
+    int new_size = pool->candidates_size ? pool->candidates_size * 2 : 16;
+    spot_candidate_t* temp = realloc(pool->candidates, new_size * sizeof(spot_candidate_t));
+    CHECK_MALLOC(temp, fail);
+    pool->candidates = temp;
+    pool->candidates_size = new_size;
+    return 0;
+    fail:
+    return -1;
+}
+
+/**
+ * @brief Ordina i candidati per distanza crescente.
+ */
+static int compare_candidates(const void* a, const void* b) {
+    return ((const spot_candidate_t*)a)->distance - ((const spot_candidate_t*)b)->distance;
+}
+
+/**
+ * @brief Distanza minima di Manhattan tra un punto e una cella della griglia.
+ */
+static int cell_lower_bound(int cx, int cy, int x, int y) {
+    int min_x = cx * GRID_CELL_SIZE, max_x = min_x + GRID_CELL_SIZE - 1;
+    int min_y = cy * GRID_CELL_SIZE, max_y = min_y + GRID_CELL_SIZE - 1;
+    int dx = x < min_x ? min_x - x : (x > max_x ? x - max_x : 0);
+    int dy = y < min_y ? min_y - y : (y > max_y ? y - max_y : 0);
+    return dx + dy;
+}
+
+/**
+ * @brief Preleva gli n soccorritori liberi del tipo indicato più vicini a un punto (tutti o nessuno).
+ *
+ * La ricerca visita la griglia ad anelli concentrici attorno alla cella del punto e si ferma
+ * appena gli n candidati trovati sono sicuramente più vicini di qualunque cella non ancora visitata.
+ * I soccorritori in rientro sono candidati fin dall'inizio, alla posizione pubblicata dal motore di movimento.
+ * A parità di velocità del tipo, i più vicini per distanza di Manhattan sono anche quelli con ETA minore.
+ *
+ * @param type_id ID del tipo di soccorritore richiesto.
+ * @param n Numero di soccorritori richiesti.
+ * @param x Coordinata X dell'emergenza.
+ * @param y Coordinata Y dell'emergenza.
+ * @param out Array in cui scrivere i soccorritori prelevati (almeno n elementi), dal più vicino.
+ * @return 0 se sono stati prelevati tutti gli n soccorritori, -1 altrimenti (nessuno prelevato).
+ */
+int rescuer_pool_take_nearest(int type_id, int n, int x, int y, rescuer_thread_t** out) {
+    if (type_id < 0 || type_id >= pool_count) return -1;
+    rescuer_pool_t* pool = &pools[type_id];
+    mtx_lock(&pool->mutex);
+    if (pool->idle_count < n) {
+        mtx_unlock(&pool->mutex);
+        return -1; // Non ci sono abbastanza soccorritori liberi
+    }
+
+    int cx = cell_coord(x, grid_w);
+    int cy = cell_coord(y, grid_h);
+    int max_ring = grid_w > grid_h ? grid_w : grid_h;
+    int found = 0;
+
+    // I soccorritori in rientro, ciascuno nel punto raggiunto (non in quello da cui è partito)
+    for (rescuer_thread_t* r = pool->moving.head; r; r = r->next_idle) {
+        if (grow_candidates(pool, found) != 0) goto fail;
+        int ux, uy;
+        fleet_position(r->twin->id, &ux, &uy);
+        pool->candidates[found++] = (spot_candidate_t){ .spot = &pool->moving, .unit = r,
+            .distance = abs(ux - x) + abs(uy - y) };
+    }
+
+    for (int ring = 0; ring <= max_ring; ring++) {
+        // Visita le celle sul perimetro dell'anello di raggio ring
+        for (int gy = cy - ring; gy <= cy + ring; gy++) {
+            if (gy < 0 || gy >= grid_h) continue;
+            int step = (gy == cy - ring || gy == cy + ring) ? 1 : 2 * ring;
+            for (int gx = cx - ring; gx <= cx + ring; gx += step) {
+                if (gx < 0 || gx >= grid_w) continue;
+                for (idle_spot_t* spot = pool->cells[gy * grid_w + gx]; spot; spot = spot->next) {
+                    if (grow_candidates(pool, found) != 0) goto fail;
+                    pool->candidates[found++] = (spot_candidate_t){ .spot = spot,
+                        .distance = abs(spot->x - x) + abs(spot->y - y) };
+                }
+            }
+        }
+
+        // Le celle dell'anello successivo distano almeno next_bound: conta i soccorritori già più vicini
+        int next_bound = ring * GRID_CELL_SIZE + cell_lower_bound(cx, cy, x, y);
+        int sure = 0;
+        for (int i = 0; i < found && sure < n; i++) {
+            const spot_candidate_t* c = &pool->candidates[i];
+            if (c->distance <= next_bound) sure += c->unit ? 1 : c->spot->count;
+        }
+        if (sure >= n) break;
+    }
+
+    // Preleva i soccorritori partendo dagli spot più vicini
+    qsort(pool->candidates, found, sizeof(spot_candidate_t), compare_candidates);
+    int taken = 0;
+    for (int i = 0; i < found && taken < n; i++) {
+        if (pool->candidates[i].unit) {
+            out[taken++] = pool->candidates[i].unit;
+            pool_unlink(pool, pool->candidates[i].unit);
+            continue;
+        }
+        idle_spot_t* spot = pool->candidates[i].spot;
+        int available = spot->count;
+        for (int k = 0; k < available && taken < n; k++) {
+            rescuer_thread_t* r = spot->head;
+            out[taken++] = r;
+            pool_unlink(pool, r); // Può riciclare lo spot quando si svuota (dopo l'ultimo prelievo)
+        }
+    }
+    mtx_unlock(&pool->mutex);
+    return 0;
+    fail:
+    mtx_unlock(&pool->mutex);
+    return -1;
+}
+
+/**
+ * @brief Preleva tutti i soccorritori liberi del tipo indicato (al più max).
+ *
+ * Usata dallo scheduler a blocchi, che decide da sé come distribuirli tra le emergenze
+ * e restituisce con rescuer_pool_put quelli che non usa.
+ *
+ * @param type_id ID del tipo di soccorritore.
+ * @param out Array in cui scrivere i soccorritori prelevati (almeno max elementi).
+ * @param max Numero massimo di soccorritori da prelevare.
+ * @return Numero di soccorritori prelevati.
+ */
+int rescuer_pool_take_all(int type_id, rescuer_thread_t** out, int max) {
+    if (type_id < 0 || type_id >= pool_count) return 0;
+    rescuer_pool_t* pool = &pools[type_id];
+    int taken = 0;
+    mtx_lock(&pool->mutex);
+    for (int c = 0; c < grid_w * grid_h && taken < max; c++) {
+        // pool_unlink ricicla gli spot svuotati: si riparte sempre dalla testa della cella
+        while (pool->cells[c] && taken < max) {
+            rescuer_thread_t* r = pool->cells[c]->head;
+            out[taken++] = r;
+            pool_unlink(pool, r);
+        }
+    }
+    while (pool->moving.head && taken < max) {
+        rescuer_thread_t* r = pool->moving.head;
+        out[taken++] = r;
+        pool_unlink(pool, r);
+    }
+    mtx_unlock(&pool->mutex);
+    return taken;
+}
+
+/**
+ * @brief Numero di soccorritori liberi del tipo indicato.
+ * @param type_id ID del tipo di soccorritore.
+ * @return Numero di soccorritori liberi (0 se il tipo non esiste).
+ */
+int rescuer_pool_idle_count(int type_id) {
+    if (type_id < 0 || type_id >= pool_count) return 0;
+    mtx_lock(&pools[type_id].mutex);
+    int idle_count = pools[type_id].idle_count;
+    mtx_unlock(&pools[type_id].mutex);
+    return idle_count;
+}
@@ -7,156 +7,951 @@
 #include "logger.h"
 #include "emergency_status.h"
 #include "macros.h"
+#include "rescuer_pool.h"
+#include "rescuer.h"
+#include "fleet.h"
+#include "sim_clock.h"
+#include "assignment.h"
+#include "waitlist.h"
+#include "eta.h"
+#include "eta_table.h"
 #include <threads.h>
 
+// Numero massimo di emergenze raccolte in un blocco dallo scheduler a blocchi
+#define BATCH_MAX_EMERGENCIES 32
+// Costo di un posto in squadra lasciato scoperto (domina qualunque tempo di viaggio)
+#define UNSERVED_COST 1000000LL
+
 /**
- * @brief Funzione eseguita dal thread scheduler.
- * Estrae emergenze dalla coda, valuta se possono essere gestite e assegna i soccorritori disponibili.
- * @param arg Puntatore a scheduler_args_t.
- * @return NULL.
+ * @brief Soccorritori liberi di un tipo prelevati per un blocco di emergenze.
  */
-int scheduler_thread_fun(void* arg) {
-    scheduler_args_t* args = (scheduler_args_t*)arg;
-    rescuer_thread_t* rescuers = args->rescuers;
-    int rescuer_count = args->rescuer_count;
+typedef struct {
+    rescuer_thread_t** units;       // Soccorritori prelevati dal pool del tipo
+    int count;                      // Numero di soccorritori prelevati
+    int capacity;                   // Numero totale di soccorritori del tipo
+    unsigned char* taken;           // Soccorritori già usati nella simulazione greedy
+    int* xs;                        // Posizioni dei soccorritori prelevati (array paralleli per il kernel ETA)
+    int* ys;
+    int* eta;                       // ETA dei soccorritori verso l'emergenza in esame
+    int* cand;                      // Soccorritori candidati nell'assegnamento (indici in units)
+    unsigned char* in_cand;         // 1 se il soccorritore è già tra i candidati
+    int speed;                      // Velocità del tipo
+} unit_group_t;
 
-    while (1) {
-        // 1. Attende ed estrae emergenza con priorità più alta (gestisce il mutex internamente)
-        emergency_t* e = emergency_queue_get();
-
-        printf("🧭 [SCHEDULER] Emergenza da gestire: %s (%d,%d), priorità %d\n",
-               e->type.emergency_desc, e->x, e->y, e->type.priority);
-
-        // Controlla se l'emergenza può essere gestita in tempo in base alla priorità
-        int max_time = 0;
-        int time_to_manage = 0;
-        switch (e->type.priority)
-        {
-        case 0:
-            max_time = -1; // priorità 0, non ha un tempo massimo
-            break;
-        case 1:
-            max_time = 30; // priorità 1, tempo massimo 30 secondi
-            break;
-        case 2:
-            max_time = 10; // priorità 2, tempo massimo 10 secondi
-            break;
-        default:
-            printf("❌ [SCHEDULER] Priorità non valida: %d\n", e->type.priority);
-            char log_msg[256];
-            snprintf(log_msg, sizeof(log_msg), "Priorità non valida: %d", e->type.priority);
-            char id [5];
-            snprintf(id, sizeof(id), "1%3d", e->id);
-            log_event(id, "EMERGENCY_SCHEDULER", log_msg);
-            update_emergency_status(e, CANCELED); // Aggiorna lo stato dell'emergenza
+/**
+ * @brief Emergenza di un blocco con la squadra proposta dall'assegnamento.
+ */
+typedef struct {
+    emergency_t* e;                 // Emergenza
+    int max_time;                   // Tempo massimo di gestione (-1 se senza limite)
+    int active;                     // 1 finché l'emergenza può ancora essere servita
+    rescuer_thread_t** team;        // Soccorritori assegnati, nell'ordine delle richieste del tipo
+    int arrival;                    // Tempo di arrivo dell'ultimo soccorritore della squadra
+    int time_to_manage;             // Tempo stimato di gestione
+    const rescuer_request_t* missing; // Richiesta rimasta scoperta (NULL se la squadra è completa)
+} batch_entry_t;
+
+// Soccorritori liberi per tipo, indicizzati per ID del tipo (usati solo dal thread scheduler)
+static unit_group_t* groups = NULL;
+static int group_count = 0;
+
+// Tutti i soccorritori del sistema, indicizzati per ID del gemello digitale (richiamabili dalla prelazione)
+static rescuer_thread_t* all_rescuers = NULL;
+static int all_rescuer_count = 0;
+
+// Totali dall'avvio delle prelazioni eseguite
+static long preemption_total = 0, recalled_total = 0;
+
+/**
+ * @brief Soccorritore impegnato su un'emergenza che potrebbe essere sospesa per prelazione.
+ */
+typedef struct {
+    emergency_t* victim;            // Emergenza in corso su cui è impegnato (solo per rescuer_preempt_prepare, che la riverifica)
+    int victim_id;                  // ID dell'emergenza, letto sotto il mutex del soccorritore
+    short priority;                 // Priorità dell'emergenza, letta sotto il mutex del soccorritore
+    int x;                          // Coordinata X dell'emergenza, letta sotto il mutex del soccorritore
+    int y;                          // Coordinata Y dell'emergenza, letta sotto il mutex del soccorritore
+    int type_id;                    // Tipo del soccorritore (dagli array della flotta)
+    rescuer_thread_t* unit;         // Soccorritore
+} preempt_candidate_t;
+
+/**
+ * @brief ID del gemello digitale di un soccorritore, dalla sua posizione in all_rescuers
+ * (senza seguire il puntatore al gemello).
+ */
+static int unit_id(const rescuer_thread_t* r) {
+    return (int)(r - all_rescuers);
+}
+
+// Totali dall'avvio per il confronto tra assegnamento a blocchi e greedy
+static long batch_served_total = 0, greedy_served_total = 0;
+static long batch_response_total = 0, greedy_response_total = 0;
+
+/**
+ * @brief Tempo massimo di gestione di un'emergenza in base alla sua priorità.
+ * Un'emergenza sospesa per prelazione (PAUSED) era già stata presa in carico: non ha più un tempo massimo.
+ * @param e Emergenza.
+ * @param max_time Restituisce il tempo massimo in secondi (-1 se senza limite).
+ * @return 0 se la priorità è valida, -1 altrimenti.
+ */
+static int max_time_for(const emergency_t* e, int* max_time) {
+    if (e->status == PAUSED && e->priority >= 0 && e->priority <= 2) {
+        *max_time = -1;
+        return 0;
+    }
+    switch (e->priority)
+    {
+    case 0:
+        *max_time = -1; // priorità 0, non ha un tempo massimo
+        return 0;
+    case 1:
+        *max_time = 30; // priorità 1, tempo massimo 30 secondi
+        return 0;
+    case 2:
+        *max_time = 10; // priorità 2, tempo massimo 10 secondi
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Annulla un'emergenza con priorità non valida.
+ */
+static void cancel_invalid(emergency_t* e) {
+    printf("❌ [SCHEDULER] Priorità non valida: %d\n", e->priority);
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Priorità non valida: %d", e->priority);
+    char id [5];
+    snprintf(id, sizeof(id), "1%3d", e->id);
+    log_emergency_event(e->id, id, "EMERGENCY_SCHEDULER", log_msg);
+    update_emergency_status(e, CANCELED); // Aggiorna lo stato dell'emergenza
+}
+
+/**
+ * @brief Registra che per un'emergenza mancano soccorritori liberi di un tipo.
+ */
+static void log_unavailable(const emergency_t* e, const rescuer_type_t* type) {
+    printf("❌ [SCHEDULER] Non ci sono abbastanza soccorritori disponibili per: %s\n",
+        type->rescuer_type_name);
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Non ci sono abbastanza soccorritori disponibili per: %s",
+        type->rescuer_type_name);
+    char id [5];
+    snprintf(id, sizeof(id), "1%03d", e->id);
+    log_emergency_event(e->id, id, "EMERGENCY_SCHEDULER", log_msg);
+}
+
+/**
+ * @brief Registra che un'emergenza non può essere gestita entro il tempo massimo.
+ */
+static void log_too_late(const emergency_t* e, int time_to_manage) {
+    printf("❌ [SCHEDULER] Emergenza scartata: %s (%d,%d), tempo massimo superato\n",
+           e->type->emergency_desc, e->x, e->y);
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Emergenza scartata: %s (%d,%d), richiesti %d secondi per la gestione (priorità %d)",
+           e->type->emergency_desc, e->x, e->y, time_to_manage, e->priority);
+    char id [5];
+    snprintf(id, sizeof(id), "1%03d", e->id);
+    log_emergency_event(e->id, id, "EMERGENCY_SCHEDULER", log_msg);
+}
+
+/**
+ * @brief Tempo di viaggio di un soccorritore libero fino al luogo di un'emergenza.
+ * Per un soccorritore in rientro alla base si parte dal punto raggiunto finora; da fermo alla base
+ * il tempo è quello precalcolato nella tabella del tipo.
+ */
+static int travel_time(const emergency_t* e, const rescuer_thread_t* r) {
+    const rescuer_type_t* type = r->twin->rescuer;
+    int x, y;
+    rescuer_position(r, &x, &y);
+    if (x == type->x && y == type->y) {
+        int travel = eta_table_lookup(type->id, e->x, e->y);
+        if (travel >= 0) return travel;
+    }
+    return ( abs(e->x - x) + abs(e->y - y) ) / type->speed;
+}
+
+/**
+ * @brief Secondi già trascorsi dall'emergenza in attesa di soccorritori liberi (vedi waitlist.h).
+ */
+static int waited_seconds(const emergency_t* e) {
+    return e->waiting_since ? (int)((sim_now() - e->waiting_since) / 1000) : 0;
+}
+
+/**
+ * @brief Tempo di intervento di un posto della squadra, meno quello già svolto nel posto prima di una sospensione.
+ * @param req Richiesta a cui appartiene il posto.
+ * @param slot Posto nella squadra (indice in e->slots).
+ */
+static int manage_time(const emergency_t* e, const rescuer_request_t* req, int slot) {
+    int done = e->slots[slot].work_done;
+    return req->time_to_manage > done ? req->time_to_manage - done : 0;
+}
+
+/**
+ * @brief Tempo di intervento ancora da svolgere per una richiesta: il più lungo tra i suoi posti.
+ * @param i Indice della richiesta nel tipo dell'emergenza.
+ */
+static int request_manage_time(const emergency_t* e, int i) {
+    int first = 0;
+    for (int k = 0; k < i; k++) first += e->type->rescuers[k].required_count;
+    int longest = 0;
+    for (int c = 0; c < e->type->rescuers[i].required_count; c++) {
+        if (manage_time(e, &e->type->rescuers[i], first + c) > longest) longest = manage_time(e, &e->type->rescuers[i], first + c);
+    }
+    return longest;
+}
+
+/**
+ * @brief Tempo di intervento ancora da svolgere per l'intera emergenza: il più lungo tra le richieste.
+ */
+static int remaining_work(const emergency_t* e) {
+    int longest = 0;
+    for (int i = 0; i < e->type->rescuers_req_number; i++) {
+        if (request_manage_time(e, i) > longest) longest = request_manage_time(e, i);
+    }
+    return longest;
+}
+
+/**
+ * @brief Tempo minimo che servirà a un'emergenza parcheggiata una volta liberi i soccorritori mancanti.
+ * Il lavoro residuo è il più lungo tra i tipi richiesti; per il tipo mancante si aggiunge il viaggio dalla
+ * sua base, da dove ripartono i soccorritori che rientrano (senza rientro può liberarsene uno già sul posto).
+ */
+static int park_time(const emergency_t* e, const rescuer_request_t* missing) {
+    int min_time = remaining_work(e);
+    int travel = 0;
+    if (rescuer_returns_to_base()) {
+        const rescuer_type_t* type = missing->type;
+        travel = eta_table_lookup(type->id, e->x, e->y);
+        if (travel < 0) travel = ( abs(e->x - type->x) + abs(e->y - type->y) ) / type->speed;
+    }
+    int missing_time = request_manage_time(e, (int)(missing - e->type->rescuers));
+    if (missing_time + travel > min_time) min_time = missing_time + travel;
+    return min_time;
+}
+
+/**
+ * @brief Assegna una squadra completa a un'emergenza e la invia sul posto.
+ * @param e Emergenza (e->time già impostato).
+ * @param selected Soccorritori della squadra, nell'ordine delle richieste del tipo.
+ * @param assigned Numero di soccorritori della squadra.
+ */
+static void dispatch_team(emergency_t* e, rescuer_thread_t** selected, int assigned) {
+    char rescuers_assigned[256] = "";
+    printf("✅ [SCHEDULER] Assegnati %d soccorritori all'emergenza: %s (id: %02d)\n",
+           assigned, e->type->emergency_desc, e->id);
+    // L'assegnazione avviene in un unico istante virtuale: il tempo non avanza finché tutti sono partiti
+    sim_hold();
+    // Registra i soccorritori sull'emergenza prima di inviarli: il contatore dei soccorritori impegnati
+    // impedisce che l'emergenza venga completata (e liberata) mentre gli altri vengono ancora inviati.
+    // Lo stato del soccorritore lo cambia rescuer_dispatch, che deve sapere se interrompe un rientro
+    for (int j = 0; j < assigned; j++) {
+        e->slots[j].twin = selected[j]->twin;
+        e->rescuers_busy++;
+        size_t len = strlen(rescuers_assigned);
+        snprintf(rescuers_assigned + len, sizeof(rescuers_assigned) - len, "%s%s",
+                 selected[j]->twin->rescuer->rescuer_type_name, j != assigned - 1 ? ", " : "");
+    }
+    update_emergency_status(e, ASSIGNED); // Aggiorna lo stato dell'emergenza
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Assegnati %d soccorritori (%.150s) all'emergenza: %s",
+           assigned, rescuers_assigned, e->type->emergency_desc);
+    char id [5];
+    snprintf(id, sizeof(id), "0%03d", e->id);
+    log_emergency_event(e->id, id, "EMERGENCY_SCHEDULER", log_msg);
+
+    // Invia i soccorritori verso l'emergenza (da qui in poi l'emergenza appartiene ai soccorritori)
+    for (int j = 0; j < assigned; j++) {
+        rescuer_dispatch(selected[j], e, j);
+    }
+    sim_release();
+}
+
+/**
+ * @brief Ordina i candidati alla prelazione per priorità crescente dell'emergenza, raggruppati per emergenza.
+ */
+static int compare_preempt_candidates(const void* a, const void* b) {
+    const preempt_candidate_t* x = a;
+    const preempt_candidate_t* y = b;
+    if (x->priority != y->priority) return x->priority - y->priority;
+    if (x->victim_id != y->victim_id) return x->victim_id - y->victim_id;
+    return 0;
+}
+
+/**
+ * @brief Libera i soccorritori che mancano a un'emergenza richiamandoli da emergenze meno urgenti (prelazione).
+ *
+ * Sono richiamabili i soccorritori in viaggio o sulla scena di emergenze IN_PROGRESS con priorità
+ * minore. Le vittime vengono scelte dalla priorità più bassa e contano solo se i loro soccorritori
+ * arriverebbero entro il tempo massimo; la prelazione avviene solo se copre tutti i soccorritori
+ * mancanti. Ogni vittima viene sospesa (PAUSED), perde tutti i soccorritori, di qualunque tipo
+ * (che tornano nei pool), e torna in coda: riprenderà più tardi con il solo tempo di intervento
+ * residuo. Le vittime vengono sospese solo se i richiami di tutte riescono.
+ * Ogni decisione viene registrata nel log con il suo costo.
+ *
+ * @param e Emergenza da servire.
+ * @param max_time Tempo massimo di gestione di e (-1 se senza limite).
+ * @param waited Secondi già trascorsi da e in attesa di soccorritori.
+ * @return Numero di emergenze sospese (0 se la prelazione non è possibile o non serve).
+ */
+static int preempt_for(emergency_t* e, int max_time, int waited) {
+    int req_count = e->type->rescuers_req_number;
+    int shortage[req_count > 0 ? req_count : 1];
+    int short_types[req_count > 0 ? req_count : 1]; // Tipi con soccorritori mancanti
+    int short_total = 0, short_type_count = 0;
+    for (int i = 0; i < req_count; i++) {
+        shortage[i] = e->type->rescuers[i].required_count - rescuer_pool_idle_count(e->type->rescuers[i].type_id);
+        if (shortage[i] < 0) shortage[i] = 0;
+        short_total += shortage[i];
+        if (shortage[i] > 0) short_types[short_type_count++] = e->type->rescuers[i].type_id;
+    }
+    if (short_total == 0 || e->priority <= 0) return 0; // Niente da liberare, o nessuna emergenza meno urgente
+
+    preempt_candidate_t* candidates = malloc((all_rescuer_count > 0 ? all_rescuer_count : 1) * sizeof(preempt_candidate_t));
+    int* chosen = malloc((all_rescuer_count > 0 ? all_rescuer_count : 1) * sizeof(int)); // Inizio del gruppo di ogni vittima scelta
+    int* busy = malloc((all_rescuer_count > 0 ? all_rescuer_count : 1) * sizeof(int));
+    rescuer_thread_t** recall = NULL;   // Soccorritori da richiamare, raggruppati per vittima
+    sim_time_t* remaining = NULL;       // Tempo residuo della fase interrotta di ogni soccorritore richiamato
+    int* recall_start = NULL;
+    CHECK_MALLOC(candidates, fail);
+    CHECK_MALLOC(chosen, fail);
+    CHECK_MALLOC(busy, fail);
+    // Una passata sugli array della flotta trova chi, dei tipi mancanti, è impegnato su emergenze
+    // meno urgenti; solo questi soccorritori vengono poi verificati sotto il loro mutex
+    int busy_count = fleet_scan_busy(e->priority, short_types, short_type_count, busy);
+    int found = 0;
+    for (int k = 0; k < busy_count; k++) {
+        int em_id, slot;
+        fleet_assignment(busy[k], &em_id, &slot);
+        if (em_id < 0 || em_id == e->id) continue; // Già libero, o già impegnato su e
+        rescuer_thread_t* w = &all_rescuers[busy[k]];
+        mtx_lock(&w->mutex);
+        // L'emergenza è valida solo finché il soccorritore è impegnato su di lei: dopo lo sblocco può essere
+        // completata e riciclata, quindi i campi che servono alla scelta vengono copiati qui.
+        // Deve essere la stessa vista dalla scansione, di cui vale il filtro per priorità
+        emergency_t* v = w->current_em;
+        rescuer_status_t status = w->twin->status;
+        if (v && v->id == em_id && (status == EN_ROUTE_TO_SCENE || status == ON_SCENE)
+            && v->priority < e->priority && v->status == IN_PROGRESS) {
+            candidates[found++] = (preempt_candidate_t){ .victim = v, .victim_id = v->id,
+                .priority = v->priority, .x = v->x, .y = v->y, .type_id = fleet_type(busy[k]), .unit = w };
+        }
+        mtx_unlock(&w->mutex);
+    }
+    qsort(candidates, found, sizeof(preempt_candidate_t), compare_preempt_candidates);
+
+    // Sceglie le vittime (gruppi consecutivi di candidati) finché non copre tutti i soccorritori mancanti
+    int chosen_count = 0;
+    for (int start = 0; start < found && short_total > 0; ) {
+        const preempt_candidate_t* v = &candidates[start];
+        int end = start;
+        while (end < found && candidates[end].victim_id == v->victim_id) end++;
+
+        int useful = 0;
+        for (int i = 0; i < req_count; i++) {
+            rescuer_request_t req = e->type->rescuers[i];
+            if (shortage[i] == 0) continue;
+            // I soccorritori richiamati partono (circa) dalla posizione della vittima
+            int travel = ( abs(e->x - v->x) + abs(e->y - v->y) ) / req.type->speed;
+            if (max_time > 0 && waited + request_manage_time(e, i) + travel > max_time) continue;
+            for (int c = start; c < end && shortage[i] > 0; c++) {
+                if (candidates[c].type_id == req.type_id) {
+                    shortage[i]--;
+                    short_total--;
+                    useful = 1;
+                }
+            }
+        }
+        if (useful) chosen[chosen_count++] = start;
+        start = end;
+    }
+    if (short_total > 0) {
+        free(candidates);
+        free(chosen);
+        free(busy);
+        return 0; // Nemmeno con la prelazione l'emergenza può essere servita: non si sospende nessuno
+    }
+
+    // Una vittima si sospende solo richiamando tutti i suoi soccorritori, anche dei tipi che non mancano
+    recall = malloc((all_rescuer_count > 0 ? all_rescuer_count : 1) * sizeof(rescuer_thread_t*));
+    remaining = malloc((all_rescuer_count > 0 ? all_rescuer_count : 1) * sizeof(sim_time_t));
+    recall_start = malloc((chosen_count + 1) * sizeof(int)); // Soccorritori della vittima k: [recall_start[k], recall_start[k + 1])
+    CHECK_MALLOC(recall, fail);
+    CHECK_MALLOC(remaining, fail);
+    CHECK_MALLOC(recall_start, fail);
+    recall_start[0] = 0;
+    for (int k = 0; k < chosen_count; k++) {
+        int n = fleet_scan_emergency(candidates[chosen[k]].victim_id, busy);
+        for (int j = 0; j < n; j++) recall[recall_start[k] + j] = &all_rescuers[busy[j]];
+        recall_start[k + 1] = recall_start[k] + n;
+    }
+
+    int paused = 0;
+    sim_hold(); // Richiamo e sospensione avvengono in un unico istante virtuale
+    // Prima si preparano tutti i richiami: se una vittima è cambiata nel frattempo l'emergenza resterebbe
+    // comunque senza soccorritori, quindi non si sospende nessuno
+    int prepared = 0;
+    for (; prepared < chosen_count; prepared++) {
+        const preempt_candidate_t* v = &candidates[chosen[prepared]];
+        int first = recall_start[prepared], n = recall_start[prepared + 1] - first;
+        if (rescuer_preempt_prepare(v->victim, v->victim_id, &recall[first], n, &remaining[first]) != 0) break;
+    }
+    if (prepared < chosen_count) {
+        for (int k = 0; k < prepared; k++) {
+            int first = recall_start[k];
+            rescuer_preempt_abort(&recall[first], recall_start[k + 1] - first, &remaining[first]);
+        }
+        chosen_count = 0;
+    }
+
+    for (int k = 0; k < chosen_count; k++) {
+        emergency_t* v = candidates[chosen[k]].victim;
+        int first = recall_start[k], n = recall_start[k + 1] - first;
+        // Confermata da rescuer_preempt_prepare: sospesa e senza soccorritori, v appartiene allo scheduler
+        int work_done = 0;
+        rescuer_preempt_commit(v, candidates[chosen[k]].victim_id, &recall[first], n, &remaining[first], &work_done);
+        paused++;
+        preemption_total++;
+        recalled_total += n;
+
+        // Costo: intervento residuo rinviato e soccorritori che dovranno tornare sul posto
+        int remaining_time = remaining_work(v);
+        printf("⏸️ [SCHEDULER] Prelazione: emergenza %s (id: %02d) sospesa per %s (id: %02d)\n",
+               v->type->emergency_desc, v->id, e->type->emergency_desc, e->id);
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg),
+            "Sospesa (priorità %d) per l'emergenza %d (priorità %d, in attesa da %d s): richiamati %d soccorritori, "
+            "intervento svolto in questa ripresa fino a %d s, residuo %d s (prelazioni: %ld, soccorritori richiamati: %ld)",
+            v->priority, e->id, e->priority, waited, n, work_done, remaining_time,
+            preemption_total, recalled_total);
+        char id [5];
+        snprintf(id, sizeof(id), "0%03d", v->id);
+        log_emergency_event(v->id, id, "PREEMPTION", log_msg);
+
+        // La vittima torna in coda e riprenderà con il tempo residuo
+        // (reinserimento interno: l'hard limit della coda vale solo per i nuovi arrivi)
+        if (emergency_queue_requeue(v) != 0) {
+            snprintf(log_msg, sizeof(log_msg), "Memoria insufficiente: impossibile riaccodare l'emergenza sospesa %s",
+                     v->type->emergency_desc);
+            snprintf(id, sizeof(id), "1%03d", v->id);
+            log_emergency_event(v->id, id, "PREEMPTION", log_msg);
+            update_emergency_status(v, TIMEOUT); // L'emergenza sospesa non può essere ripresa
+        }
+    }
+    sim_release();
+    free(recall);
+    free(remaining);
+    free(recall_start);
+    free(candidates);
+    free(chosen);
+    free(busy);
+    return paused;
+    fail:
+    free(recall);
+    free(remaining);
+    free(recall_start);
+    free(candidates);
+    free(chosen);
+    free(busy);
+    return 0;
+}
+
+/**
+ * @brief Gestisce una singola emergenza con la politica greedy: i soccorritori liberi più vicini.
+ * Se mancano soccorritori prova una volta la prelazione su emergenze meno urgenti.
+ */
+static void schedule_greedy(emergency_t* e) {
+    printf("🧭 [SCHEDULER] Emergenza da gestire: %s (%d,%d), priorità %d\n",
+           e->type->emergency_desc, e->x, e->y, e->priority);
+
+    // Controlla se l'emergenza può essere gestita in tempo in base alla priorità
+    int max_time = 0;
+    int time_to_manage = 0;
+    if (max_time_for(e, &max_time) != 0) {
+        cancel_invalid(e);
+        return; // L'emergenza è stata liberata
+    }
+
+    // Per ogni tipo di soccorritore richiesto da questa emergenza preleva dal pool
+    // del tipo i soccorritori liberi più vicini al luogo dell'emergenza
+    int waited = waited_seconds(e);
+    int preempted = 0;
+    rescuer_thread_t* selected[e->rescuer_count > 0 ? e->rescuer_count : 1];
+    int assigned, ok;
+    const rescuer_request_t* missing;
+    retry:
+    assigned = 0;
+    ok = 1;
+    time_to_manage = 0;
+    missing = NULL;
+    for (int i = 0; i < e->type->rescuers_req_number; i++) {
+        rescuer_request_t req = e->type->rescuers[i];
+        // Preleva i soccorritori disponibili del tipo richiesto
+        if (rescuer_pool_take_nearest(req.type_id, req.required_count, e->x, e->y, &selected[assigned]) != 0) {
+            // Non ci sono abbastanza soccorritori disponibili
+            missing = &e->type->rescuers[i];
+            ok = 0;
             break;
         }
 
-        // Calcola il tempo massimo necessario per la gestione dell'emergenza
-        for (int i = 0; i < e->type.rescuers_req_number; i++) {
-            rescuer_request_t req = e->type.rescuers[i];
-            int travel_time = ( abs(e->x - req.type->x) + abs(e->y - req.type->y) ) / req.type->speed;
-            if(req.time_to_manage + travel_time > time_to_manage) {
-                time_to_manage = req.time_to_manage + travel_time;
+        // Calcola il tempo di gestione a partire dalla posizione reale dei soccorritori scelti
+        for (int j = assigned; j < assigned + req.required_count; j++) {
+            int travel = travel_time(e, selected[j]);
+            if(manage_time(e, &req, j) + travel > time_to_manage) {
+                time_to_manage = manage_time(e, &req, j) + travel;
             }
         }
-        e->time=time_to_manage; // Salva il tempo stimato per la gestione dell'emergenza
-        // Se il tempo di gestione supera il massimo, scarta l'emergenza
+        assigned += req.required_count;
+        printf("🧭 [SCHEDULER] %d soccorritori del tipo %s disponibili\n",
+               req.required_count, req.type->rescuer_type_name);
+    }
+    e->time=time_to_manage; // Salva il tempo stimato per la gestione dell'emergenza
+
+    if (ok) {
+        // Se il tempo di gestione (più l'eventuale attesa) supera il massimo, scarta l'emergenza
         printf("🧭 [SCHEDULER] Tempo di gestione stimato: %d secondi\n", time_to_manage);
-        if (max_time > 0 && time_to_manage > max_time) {
-            printf("❌ [SCHEDULER] Emergenza scartata: %s (%d,%d), tempo massimo superato\n",
-                   e->type.emergency_desc, e->x, e->y);
-            char log_msg[256];
-            snprintf(log_msg, sizeof(log_msg), "Emergenza scartata: %s (%d,%d), richiesti %d secondi per la gestione (priorità %d)",
-                   e->type.emergency_desc, e->x, e->y, time_to_manage, e->type.priority);
-            char id [5];
-            snprintf(id, sizeof(id), "1%03d", e->id);
-            log_event(id, "EMERGENCY_SCHEDULER", log_msg);
-            update_emergency_status(e, TIMEOUT); // Aggiorna lo stato dell'emergenza
-            continue; // Passa alla prossima emergenza
-        }
-
-        // 2. Per ogni tipo di soccorritore richiesto da questa emergenza
-        int assigned = 0;
-        int total_needed = 0;
-        // Array dinamico per i soccorritori selezionati
-        rescuer_digital_twin_t** digital_twins_selected = NULL;
-        for (int i = 0; i < e->type.rescuers_req_number; i++) {
-            rescuer_request_t req = e->type.rescuers[i];
-            // Numero di soccorritori richiesti di un certo tipo
-            int needed = req.required_count;
-            total_needed += needed;
-            rescuer_digital_twin_t** temp = realloc(digital_twins_selected, total_needed * sizeof(rescuer_digital_twin_t));
-            if (temp == NULL) {
-                perror("❌ Errore realloc");
-                // free(digital_twins_selected);
-                digital_twins_selected = NULL;
-                return 1; // O gestisci l'errore
+        if (max_time > 0 && waited + time_to_manage > max_time) {
+            log_too_late(e, waited + time_to_manage);
+            ok = 0;
+        }
+    }
+
+    if (!ok) {
+        // Restituisce ai pool i soccorritori già prelevati
+        for (int j = 0; j < assigned; j++) {
+            rescuer_pool_put(selected[j]);
+        }
+        // Soccorritori liberati richiamandoli da emergenze meno urgenti: nuovo tentativo
+        if (missing && !preempted) {
+            preempted = 1;
+            if (preempt_for(e, max_time, waited) > 0) goto retry;
+        }
+        // Soccorritori del tipo tutti impegnati: se c'è ancora tempo l'emergenza attende che se ne liberi qualcuno
+        if (missing && waitlist_park(e, missing, max_time, park_time(e, missing)) == 0) return;
+        if (missing) log_unavailable(e, missing->type);
+        update_emergency_status(e, TIMEOUT); // Aggiorna lo stato dell'emergenza
+        return;
+    }
+
+    dispatch_team(e, selected, assigned);
+}
+
+/**
+ * @brief Prepara i gruppi dei soccorritori per tipo, dimensionati sul numero di soccorritori di ogni tipo.
+ * @return 0 in caso di successo, -1 se la memoria è insufficiente.
+ */
+static int groups_init(const rescuer_thread_t* rescuers, int rescuer_count) {
+    for (int i = 0; i < rescuer_count; i++) {
+        if (fleet_type(i) >= group_count) group_count = fleet_type(i) + 1;
+    }
+    groups = calloc(group_count > 0 ? group_count : 1, sizeof(unit_group_t));
+    CHECK_MALLOC(groups, fail);
+    for (int i = 0; i < rescuer_count; i++) {
+        groups[fleet_type(i)].capacity++;
+        groups[fleet_type(i)].speed = rescuers[i].twin->rescuer->speed;
+    }
+    for (int t = 0; t < group_count; t++) {
+        groups[t].units = malloc((groups[t].capacity + 1) * sizeof(rescuer_thread_t*));
+        CHECK_MALLOC(groups[t].units, fail);
+        groups[t].taken = malloc(groups[t].capacity + 1);
+        CHECK_MALLOC(groups[t].taken, fail);
+        groups[t].xs = malloc((groups[t].capacity + 1) * sizeof(int));
+        CHECK_MALLOC(groups[t].xs, fail);
+        groups[t].ys = malloc((groups[t].capacity + 1) * sizeof(int));
+        CHECK_MALLOC(groups[t].ys, fail);
+        groups[t].eta = malloc((groups[t].capacity + 1) * sizeof(int));
+        CHECK_MALLOC(groups[t].eta, fail);
+        groups[t].cand = malloc((groups[t].capacity + 1) * sizeof(int));
+        CHECK_MALLOC(groups[t].cand, fail);
+        groups[t].in_cand = calloc(groups[t].capacity + 1, 1);
+        CHECK_MALLOC(groups[t].in_cand, fail);
+    }
+    return 0;
+    fail:
+    group_count = 0;
+    return -1;
+}
+
+/**
+ * @brief Simula la politica greedy sul blocco, senza prelevare né inviare nessuno.
+ * Serve come termine di confronto: stesse emergenze, stesso ordine, stessi soccorritori liberi.
+ * @param response Restituisce la somma dei tempi di arrivo delle squadre servite.
+ * @return Numero di emergenze che la politica greedy avrebbe servito.
+ */
+static int simulate_greedy(batch_entry_t* entries, int n, long* response) {
+    for (int t = 0; t < group_count; t++) memset(groups[t].taken, 0, groups[t].count);
+    int served = 0;
+    *response = 0;
+    for (int k = 0; k < n; k++) {
+        if (!entries[k].active) continue; // Scartata in partenza anche dalla politica greedy
+        emergency_t* e = entries[k].e;
+        int ok = 1, arrival = 0, time_to_manage = 0, picked = 0;
+        for (int i = 0; i < e->type->rescuers_req_number && ok; i++) {
+            rescuer_request_t req = e->type->rescuers[i];
+            if (req.type_id < 0 || req.type_id >= group_count) { ok = 0; break; }
+            unit_group_t* g = &groups[req.type_id];
+            eta_compute(g->xs, g->ys, g->count, e->x, e->y, g->speed, g->eta);
+            for (int c = 0; c < req.required_count; c++) {
+                // Il soccorritore libero più vicino, come rescuer_pool_take_nearest
+                int best = -1, best_travel = 0;
+                for (int u = 0; u < g->count; u++) {
+                    if (g->taken[u]) continue;
+                    if (best < 0 || g->eta[u] < best_travel) { best = u; best_travel = g->eta[u]; }
+                }
+                if (best < 0) { ok = 0; break; }
+                g->taken[best] = 1;
+                entries[k].team[picked] = g->units[best];
+                if (best_travel > arrival) arrival = best_travel;
+                if (manage_time(e, &req, picked) + best_travel > time_to_manage) time_to_manage = manage_time(e, &req, picked) + best_travel;
+                picked++;
+            }
+        }
+        if (ok && entries[k].max_time > 0 && time_to_manage > entries[k].max_time) ok = 0;
+        if (ok) {
+            served++;
+            *response += arrival;
+            continue;
+        }
+        // Squadra incompleta o in ritardo: i soccorritori scelti tornano disponibili
+        for (int j = 0; j < picked; j++) {
+            unit_group_t* g = &groups[fleet_type(unit_id(entries[k].team[j]))];
+            for (int u = 0; u < g->count; u++) {
+                if (g->units[u] == entries[k].team[j]) g->taken[u] = 0;
             }
-            digital_twins_selected = temp;
-
-            // 3. Cerca i soccorritori disponibili del tipo richiesto
-            for (int j = 0; j < rescuer_count && needed > 0; j++) {
-                rescuer_digital_twin_t* r = rescuers[j].twin;
-
-                // Cerca un soccorritore del tipo richiesto, libero
-                if (r->status == IDLE &&
-                    strcmp(r->rescuer->rescuer_type_name, req.type->rescuer_type_name) == 0) {
-                        digital_twins_selected[assigned] = r; // Salva il soccorritore selezionato
-                        assigned++;
-                        needed--;
+        }
+    }
+    return served;
+}
+
+/**
+ * @brief Assegna i soccorritori di un tipo alle emergenze attive con l'algoritmo ungherese.
+ *
+ * Ogni posto in squadra richiesto dalle emergenze attive è una riga, ogni soccorritore libero
+ * una colonna; il costo è il tempo di viaggio pesato per (1 + priorità). Una colonna fittizia
+ * per riga permette di lasciare scoperto un posto a costo UNSERVED_COST, anch'esso pesato per
+ * priorità: se i soccorritori non bastano restano scoperte per prime le emergenze meno urgenti.
+ * Un soccorritore che arriverebbe oltre il tempo massimo costa più del posto scoperto.
+ * Con più soccorritori che posti, le colonne sono solo i `rows` soccorritori più vicini di ogni
+ * posto: un posto assegnato più lontano troverebbe sempre libero uno di questi, senza costare di più.
+ *
+ * @return 0 in caso di successo, -1 se la memoria è insufficiente.
+ */
+static int assign_type(int type_id, batch_entry_t* entries, int n) {
+    unit_group_t* g = &groups[type_id];
+    int rows = 0;
+    for (int k = 0; k < n; k++) {
+        if (!entries[k].active) continue;
+        const emergency_type_t* et = entries[k].e->type;
+        for (int i = 0; i < et->rescuers_req_number; i++) {
+            if (et->rescuers[i].type_id == type_id) rows += et->rescuers[i].required_count;
+        }
+    }
+    if (rows == 0) return 0;
+
+    long long* cost = NULL;
+    int* row_to_col = malloc(rows * sizeof(int));
+    rescuer_thread_t*** slot = malloc(rows * sizeof(rescuer_thread_t**));
+    long long* unserved = malloc(rows * sizeof(long long));
+    int* near_idx = malloc(rows * sizeof(int));
+    int* near_eta = malloc(rows * sizeof(int));
+    CHECK_MALLOC(row_to_col, fail);
+    CHECK_MALLOC(slot, fail);
+    CHECK_MALLOC(unserved, fail);
+    CHECK_MALLOC(near_idx, fail);
+    CHECK_MALLOC(near_eta, fail);
+
+    // Sceglie le colonne: tutti i soccorritori, o l'unione dei più vicini a ogni posto
+    int cand_count = 0;
+    if (g->count <= rows) {
+        for (int u = 0; u < g->count; u++) g->cand[cand_count++] = u;
+    } else {
+        for (int k = 0; k < n; k++) {
+            if (!entries[k].active) continue;
+            emergency_t* e = entries[k].e;
+            for (int i = 0; i < e->type->rescuers_req_number; i++) {
+                if (e->type->rescuers[i].type_id != type_id) continue;
+                int found = eta_top_k(g->xs, g->ys, g->count, e->x, e->y, g->speed, rows, near_idx, near_eta);
+                for (int j = 0; j < found; j++) {
+                    if (g->in_cand[near_idx[j]]) continue;
+                    g->in_cand[near_idx[j]] = 1;
+                    g->cand[cand_count++] = near_idx[j];
                 }
             }
-            
-            if (needed > 0) {
-                // Se non ci sono abbastanza soccorritori disponibili, scarta l'emergenza
-                printf("❌ [SCHEDULER] Non ci sono abbastanza soccorritori disponibili per: %s\n",
-                    req.type->rescuer_type_name);
-                char log_msg[256];
-                snprintf(log_msg, sizeof(log_msg), "Non ci sono abbastanza soccorritori disponibili per: %s",
-                    req.type->rescuer_type_name);
-                char id [5];
-                snprintf(id, sizeof(id), "1%03d", e->id);
-                log_event(id, "EMERGENCY_SCHEDULER", log_msg);
-                update_emergency_status(e, TIMEOUT); // Aggiorna lo stato dell'emergenza
-                free(digital_twins_selected);
-                break; // riprendi dal ciclo while
+        }
+        for (int c = 0; c < cand_count; c++) g->in_cand[g->cand[c]] = 0;
+    }
+
+    int cols = cand_count + rows;
+    cost = malloc((size_t)rows * cols * sizeof(long long));
+    CHECK_MALLOC(cost, fail);
+
+    int r = 0;
+    for (int k = 0; k < n; k++) {
+        if (!entries[k].active) continue;
+        emergency_t* e = entries[k].e;
+        long long weight = 1 + e->priority;
+        int offset = 0;
+        for (int i = 0; i < e->type->rescuers_req_number; i++) {
+            rescuer_request_t req = e->type->rescuers[i];
+            // I posti della stessa richiesta condividono gli ETA: un solo calcolo per richiesta
+            if (req.type_id == type_id) eta_compute(g->xs, g->ys, g->count, e->x, e->y, g->speed, g->eta);
+            for (int c = 0; c < req.required_count && req.type_id == type_id; c++, r++) {
+                long long* row = &cost[(size_t)r * cols];
+                unserved[r] = UNSERVED_COST * weight;
+                for (int u = 0; u < cand_count; u++) {
+                    int travel = g->eta[g->cand[u]];
+                    int late = entries[k].max_time > 0 && manage_time(e, &req, offset + c) + travel > entries[k].max_time;
+                    row[u] = late ? unserved[r] + 1 : travel * weight;
+                }
+                for (int d = cand_count; d < cols; d++) row[d] = unserved[r];
+                slot[r] = &entries[k].team[offset + c];
             }
+            offset += req.required_count;
+        }
+    }
 
-            // Se sono stati assegnati tutti i soccorritori richiesti
-            if (needed == 0) {
-                printf("🧭 [SCHEDULER] %d soccorritori del tipo %s disponibili\n",
-                       req.required_count, req.type->rescuer_type_name);
-            }  
-        }
-
-        if (assigned == total_needed) {
-            // 4. Assegna i soccorritori all'emergenza
-            e->rescuers_dt = digital_twins_selected;
-
-            char rescuers_assigned[64] = "";
-            printf("✅ [SCHEDULER] Assegnati %d soccorritori all'emergenza: %s (id: %02d)\n",
-                   assigned, e->type.emergency_desc, e->id);
-            // Risveglia i soccorritori assegnati e aggiorna i loro stati
-            for (int j = 0; j < assigned; j++) {
-                rescuer_digital_twin_t* r = digital_twins_selected[j];
-                mtx_lock(&rescuers[r->id].mutex);
-                r->status = EN_ROUTE_TO_SCENE;
-                rescuers[r->id].current_em = e;
-                mtx_unlock(&rescuers[r->id].mutex);
-                cnd_signal(&rescuers[r->id].cond);
-                strcat(rescuers_assigned, rescuers[r->id].twin->rescuer->rescuer_type_name);
-                if(j != assigned-1) strcat(rescuers_assigned, ", ");
+    if (assignment_solve(rows, cols, cost, row_to_col) != 0) goto fail;
+    for (r = 0; r < rows; r++) {
+        int col = row_to_col[r];
+        // Colonna fittizia o soccorritore in ritardo: il posto resta scoperto
+        *slot[r] = col < cand_count && cost[(size_t)r * cols + col] < unserved[r] ? g->units[g->cand[col]] : NULL;
+    }
+    free(cost);
+    free(row_to_col);
+    free(slot);
+    free(unserved);
+    free(near_idx);
+    free(near_eta);
+    return 0;
+    fail:
+    free(cost);
+    free(row_to_col);
+    free(slot);
+    free(unserved);
+    free(near_idx);
+    free(near_eta);
+    return -1;
+}
+
+/**
+ * @brief Gestisce un blocco di emergenze con un assegnamento globale a costo minimo.
+ *
+ * Preleva tutti i soccorritori liberi dei tipi richiesti e li distribuisce tra le emergenze
+ * del blocco risolvendo un problema di assegnamento per ogni tipo di soccorritore. Una squadra
+ * serve solo se completa ed entro il tempo massimo: finché qualche emergenza resta scoperta,
+ * la meno urgente tra queste viene scartata e l'assegnamento viene ricalcolato sulle altre.
+ * Il risultato viene confrontato con quello che avrebbe ottenuto la politica greedy.
+ */
+static void schedule_batch(emergency_t** batch, int n) {
+    batch_entry_t entries[BATCH_MAX_EMERGENCIES];
+    rescuer_thread_t** team_slots = NULL;
+    int count = 0, slots = 0;
+
+    // Le emergenze con priorità non valida vengono annullate subito
+    for (int k = 0; k < n; k++) {
+        int max_time;
+        if (max_time_for(batch[k], &max_time) != 0) {
+            cancel_invalid(batch[k]);
+            continue;
+        }
+        entries[count] = (batch_entry_t){ .e = batch[k], .max_time = max_time, .active = 1 };
+        if (max_time > 0) {
+            // Il tempo già passato in attesa di soccorritori si scala dal tempo massimo
+            int waited = waited_seconds(batch[k]);
+            entries[count].max_time -= waited;
+            if (entries[count].max_time <= 0) {
+                entries[count].active = 0;
+                entries[count].time_to_manage = waited;
+            }
+        }
+        slots += batch[k]->rescuer_count;
+        count++;
+    }
+    if (count == 0) return;
+    printf("🧭 [SCHEDULER] Blocco di %d emergenze da gestire\n", count);
+
+    team_slots = calloc(slots > 0 ? slots : 1, sizeof(rescuer_thread_t*));
+    if (!team_slots || group_count == 0) goto fallback;
+    for (int k = 0, offset = 0; k < count; k++) {
+        entries[k].team = &team_slots[offset];
+        offset += entries[k].e->rescuer_count;
+    }
+
+    // Preleva tutti i soccorritori liberi dei tipi richiesti dal blocco
+    for (int t = 0; t < group_count; t++) groups[t].count = 0;
+    for (int k = 0; k < count; k++) {
+        const emergency_type_t* et = entries[k].e->type;
+        for (int i = 0; i < et->rescuers_req_number; i++) {
+            int type_id = et->rescuers[i].type_id;
+            if (type_id < 0 || type_id >= group_count) {
+                // Nessun soccorritore di questo tipo nel sistema: l'emergenza non può essere servita
+                entries[k].active = 0;
+                entries[k].missing = &et->rescuers[i];
+                continue;
+            }
+            unit_group_t* g = &groups[type_id];
+            if (g->count == 0) {
+                g->count = rescuer_pool_take_all(type_id, g->units, g->capacity);
+                // Posizioni in array paralleli per il kernel ETA, lette dagli array della flotta
+                for (int u = 0; u < g->count; u++) fleet_position(unit_id(g->units[u]), &g->xs[u], &g->ys[u]);
+            }
+        }
+    }
+
+    long greedy_response;
+    int greedy_served = simulate_greedy(entries, count, &greedy_response);
+
+    // Assegnamento per tipo, ripetuto finché tutte le emergenze attive hanno una squadra valida
+    while (1) {
+        for (int t = 0; t < group_count; t++) {
+            if (assign_type(t, entries, count) != 0) goto restore;
+        }
+        int drop = -1;
+        for (int k = 0; k < count; k++) {
+            if (!entries[k].active) continue;
+            emergency_t* e = entries[k].e;
+            int offset = 0;
+            entries[k].arrival = 0;
+            entries[k].time_to_manage = 0;
+            entries[k].missing = NULL;
+            for (int i = 0; i < e->type->rescuers_req_number; i++) {
+                rescuer_request_t req = e->type->rescuers[i];
+                for (int c = 0; c < req.required_count; c++) {
+                    rescuer_thread_t* r = entries[k].team[offset + c];
+                    if (!r) {
+                        if (!entries[k].missing) entries[k].missing = &e->type->rescuers[i];
+                        continue;
+                    }
+                    int travel = travel_time(e, r);
+                    if (travel > entries[k].arrival) entries[k].arrival = travel;
+                    if (manage_time(e, &req, offset + c) + travel > entries[k].time_to_manage) entries[k].time_to_manage = manage_time(e, &req, offset + c) + travel;
+                }
+                offset += req.required_count;
+            }
+            int late = entries[k].max_time > 0 && entries[k].time_to_manage > entries[k].max_time;
+            if (entries[k].missing || late) drop = k; // Il blocco è in ordine di priorità: resta l'ultima
+        }
+        if (drop < 0) break;
+        entries[drop].active = 0;
+    }
+
+    // Segna i soccorritori delle squadre valide
+    for (int t = 0; t < group_count; t++) memset(groups[t].taken, 0, groups[t].count);
+    for (int k = 0; k < count; k++) {
+        if (!entries[k].active) continue;
+        for (int j = 0; j < entries[k].e->rescuer_count; j++) {
+            unit_group_t* g = &groups[fleet_type(unit_id(entries[k].team[j]))];
+            for (int u = 0; u < g->count; u++) {
+                if (g->units[u] == entries[k].team[j]) g->taken[u] = 1;
+            }
+        }
+    }
+
+    // Invia le squadre
+    int served = 0;
+    long response = 0;
+    for (int k = 0; k < count; k++) {
+        if (!entries[k].active) continue;
+        emergency_t* e = entries[k].e;
+        served++;
+        response += entries[k].arrival;
+        e->time = entries[k].time_to_manage; // Salva il tempo stimato per la gestione dell'emergenza
+        printf("🧭 [SCHEDULER] Tempo di gestione stimato: %d secondi\n", e->time);
+        dispatch_team(e, entries[k].team, e->rescuer_count);
+    }
+    // I soccorritori non assegnati tornano nei pool (prima della prelazione, che conta quelli liberi)
+    for (int t = 0; t < group_count; t++) {
+        for (int u = 0; u < groups[t].count; u++) {
+            if (!groups[t].taken[u]) rescuer_pool_put(groups[t].units[u]);
+        }
+    }
+
+    // Le emergenze rimaste senza squadra attendono i soccorritori mancanti se sono davvero tutti
+    // impegnati (con soccorritori liberi ma troppo lontani l'attesa non servirebbe), dopo aver provato
+    // a liberarli con la prelazione; altrimenti vengono scartate
+    for (int k = 0; k < count; k++) {
+        if (entries[k].active) continue;
+        emergency_t* e = entries[k].e;
+        const rescuer_request_t* missing = entries[k].missing;
+        if (missing) {
+            int idle_left = 0;
+            if (missing->type_id >= 0 && missing->type_id < group_count) {
+                unit_group_t* g = &groups[missing->type_id];
+                for (int u = 0; u < g->count; u++) idle_left += !g->taken[u];
             }
-            update_emergency_status(e, ASSIGNED); // Aggiorna lo stato dell'emergenza
-            char log_msg[256];
-            snprintf(log_msg, sizeof(log_msg), "Assegnati %d soccorritori (%s) all'emergenza: %s",
-                   assigned,rescuers_assigned ,e->type.emergency_desc);
-            char id [5];
-            snprintf(id, sizeof(id), "0%03d", e->x);
-            log_event(id, "EMERGENCY_SCHEDULER", log_msg);
+            int max_time;
+            max_time_for(e, &max_time);
+            if (idle_left < missing->required_count) {
+                // I soccorritori eventualmente liberati dalla prelazione fanno ripartire subito l'emergenza parcheggiata
+                preempt_for(e, max_time, waited_seconds(e));
+                if (waitlist_park(e, missing, max_time, park_time(e, missing)) == 0) continue;
+                log_unavailable(e, missing->type);
+            } else {
+                log_too_late(e, entries[k].time_to_manage);
+            }
+        } else {
+            log_too_late(e, entries[k].time_to_manage);
         }
+        update_emergency_status(e, TIMEOUT); // Aggiorna lo stato dell'emergenza
+    }
+
+    for (int t = 0; t < group_count; t++) groups[t].count = 0;
+
+    batch_served_total += served;
+    greedy_served_total += greedy_served;
+    batch_response_total += response;
+    greedy_response_total += greedy_response;
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg),
+        "Blocco di %d emergenze: servite %d (greedy %d), tempo di risposta totale %ld s (greedy %ld s); "
+        "dall'avvio servite %ld (greedy %ld), tempo di risposta %ld s (greedy %ld s)",
+        count, served, greedy_served, response, greedy_response,
+        batch_served_total, greedy_served_total, batch_response_total, greedy_response_total);
+    printf("📊 [SCHEDULER] %s\n", log_msg);
+    log_event("0400", "BATCH_SCHEDULER", log_msg);
+    free(team_slots);
+    return;
+
+    restore:
+    // Memoria insufficiente per l'assegnamento: restituisce i soccorritori e ripiega sul greedy
+    for (int t = 0; t < group_count; t++) {
+        for (int u = 0; u < groups[t].count; u++) rescuer_pool_put(groups[t].units[u]);
+        groups[t].count = 0;
+    }
+    fallback:
+    free(team_slots);
+    for (int k = 0; k < count; k++) schedule_greedy(entries[k].e);
+}
 
+/**
+ * @brief Funzione eseguita dal thread scheduler.
+ * Estrae emergenze dalla coda, valuta se possono essere gestite e assegna i soccorritori disponibili.
+ * Con batch_window_ms > 0 raccoglie le emergenze in blocchi e le assegna insieme (schedule_batch),
+ * altrimenti le gestisce una alla volta con la politica greedy.
+ * @param arg Puntatore a scheduler_args_t.
+ * @return NULL.
+ */
+int scheduler_thread_fun(void* arg) {
+    scheduler_args_t* args = (scheduler_args_t*)arg;
+    int batch_window_ms = args->batch_window_ms;
+    all_rescuers = args->rescuers;
+    all_rescuer_count = args->rescuer_count;
+    if (batch_window_ms > 0 && groups_init(args->rescuers, args->rescuer_count) != 0) {
+        batch_window_ms = 0; // Senza memoria per i gruppi resta la politica greedy
+    }
+
+    while (1) {
+        if (batch_window_ms > 0) {
+            // Attende la prima emergenza e raccoglie le altre in arrivo entro la finestra
+            emergency_t* batch[BATCH_MAX_EMERGENCIES];
+            int n = emergency_queue_get_batch(batch, BATCH_MAX_EMERGENCIES, batch_window_ms);
+            schedule_batch(batch, n);
+        } else {
+            // Attende ed estrae emergenza con priorità più alta (gestisce il mutex internamente)
+            schedule_greedy(emergency_queue_get());
+        }
     }
 
     return 0;
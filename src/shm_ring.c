@@ -0,0 +1,232 @@
+#include "shm_ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Attesa massima di un produttore con il ring pieno prima di ricontrollare (rete di sicurezza)
+#define SHM_RING_SPACE_WAIT_NS 100000000L
+
+/**
+ * @brief Dimensione del segmento di memoria condivisa per un ring di capacity slot.
+ */
+static size_t ring_size(uint32_t capacity) {
+    return sizeof(shm_ring_shared_t) + (size_t)capacity * sizeof(shm_ring_slot_t);
+}
+
+/**
+ * @brief Crea il descrittore locale di un segmento mappato con la capacità indicata.
+ * @return Il descrittore, NULL se manca memoria (il segmento viene smappato).
+ */
+static shm_ring_t* ring_handle(shm_ring_shared_t* shared, uint32_t capacity) {
+    shm_ring_t* ring = malloc(sizeof(shm_ring_t));
+    if (!ring) {
+        munmap(shared, ring_size(capacity));
+        errno = ENOMEM;
+        return NULL;
+    }
+    ring->shared = shared;
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    return ring;
+}
+
+/**
+ * @brief Attende su una parola futex condivisa finché vale ancora expected.
+ */
+static void futex_wait(_Atomic uint32_t* word, uint32_t expected, const struct timespec* timeout) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+/**
+ * @brief Risveglia fino a count processi in attesa su una parola futex condivisa.
+ */
+static void futex_wake(_Atomic uint32_t* word, int count) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+/**
+ * @brief Crea (ricreandolo) il ring in memoria condivisa. Usata dal backend.
+ * @param name Nome del segmento (es. "/emergenze123").
+ * @param capacity Numero minimo di slot, arrotondato alla potenza di 2 successiva.
+ * @return Il ring mappato, NULL in caso di errore (errno impostato).
+ */
+shm_ring_t* shm_ring_create(const char* name, int capacity) {
+    uint32_t cap = 2;
+    while (cap < (uint32_t)capacity && cap < (1u << 30)) cap <<= 1;
+    size_t size = ring_size(cap);
+
+    shm_unlink(name); // Rimuove il segmento se esiste già
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600); // Solo i processi dello stesso utente possono scrivere
+    if (fd < 0) return NULL;
+    if (ftruncate(fd, size) != 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = err;
+        return NULL;
+    }
+    shm_ring_shared_t* shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // Il segmento appena creato è azzerato: restano da impostare capacità e sequenze degli slot
+    shared->capacity = cap;
+    shared->backend_pid = getpid();
+    for (uint32_t i = 0; i < cap; i++)
+        atomic_init(&shared->slots[i].seq, i);
+    // Il magic viene pubblicato per ultimo: un client che lo vede trova il ring già inizializzato
+    atomic_thread_fence(memory_order_release);
+    shared->magic = SHM_RING_MAGIC;
+    shm_ring_t* ring = ring_handle(shared, cap);
+    if (!ring) shm_unlink(name);
+    return ring;
+}
+
+/**
+ * @brief Apre il ring creato dal backend. Usata dai client.
+ * @param name Nome del segmento.
+ * @return Il ring mappato, NULL se non esiste o non è valido.
+ */
+shm_ring_t* shm_ring_open(const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(shm_ring_shared_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    shm_ring_shared_t* shared = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED) return NULL;
+    atomic_thread_fence(memory_order_acquire);
+    // La capacità viene letta una sola volta e deve essere una potenza di 2 coerente con la dimensione del segmento
+    uint32_t cap = shared->capacity;
+    if (shared->magic != SHM_RING_MAGIC || cap < 2 || (cap & (cap - 1)) != 0 || ring_size(cap) != (size_t)st.st_size) {
+        munmap(shared, st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+    return ring_handle(shared, cap);
+}
+
+/**
+ * @brief Rimuove la mappatura del ring (il segmento resta finché il backend non lo ricrea).
+ */
+void shm_ring_close(shm_ring_t* ring) {
+    if (!ring) return;
+    munmap(ring->shared, ring_size(ring->capacity));
+    free(ring);
+}
+
+/**
+ * @brief Verifica che il backend che ha creato il ring sia ancora in esecuzione.
+ */
+static int backend_alive(const shm_ring_shared_t* shared) {
+    return kill(shared->backend_pid, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * @brief Riserva uno slot in cui scrivere una richiesta.
+ * Se il ring è pieno il produttore attende che il backend liberi spazio (backpressure,
+ * come mq_send su una message queue piena). A ogni risveglio senza spazio controlla che il
+ * backend sia ancora vivo: se è terminato nessuno libererà più gli slot e l'attesa fallisce.
+ * @param pos Restituisce la posizione riservata, da passare a shm_ring_publish.
+ * @return La richiesta dello slot riservato, da compilare sul posto; NULL con errno = EPIPE se il backend è terminato.
+ */
+emergency_request_t* shm_ring_reserve(shm_ring_t* ring, uint64_t* pos) {
+    shm_ring_shared_t* shared = ring->shared;
+    uint64_t p = atomic_load_explicit(&shared->head, memory_order_relaxed);
+    for (;;) {
+        shm_ring_slot_t* slot = &shared->slots[p & ring->mask];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == p) {
+            // Slot libero: prova a riservarlo (in caso di fallimento p viene aggiornato)
+            if (atomic_compare_exchange_weak_explicit(&shared->head, &p, p + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                *pos = p;
+                return &slot->req;
+            }
+        } else if (seq < p) {
+            // Ring pieno: dorme finché il backend non libera uno slot
+            uint32_t observed = atomic_load_explicit(&shared->space_seq, memory_order_acquire);
+            atomic_fetch_add_explicit(&shared->producers_waiting, 1, memory_order_seq_cst);
+            if (atomic_load_explicit(&slot->seq, memory_order_seq_cst) < p) {
+                struct timespec timeout = { 0, SHM_RING_SPACE_WAIT_NS };
+                futex_wait(&shared->space_seq, observed, &timeout);
+            }
+            atomic_fetch_sub_explicit(&shared->producers_waiting, 1, memory_order_relaxed);
+            if (atomic_load_explicit(&slot->seq, memory_order_acquire) < p && !backend_alive(shared)) {
+                errno = EPIPE;
+                return NULL;
+            }
+            p = atomic_load_explicit(&shared->head, memory_order_relaxed);
+        } else {
+            p = atomic_load_explicit(&shared->head, memory_order_relaxed); // Un altro produttore è avanzato
+        }
+    }
+}
+
+/**
+ * @brief Pubblica al backend lo slot riservato e lo risveglia se sta dormendo.
+ */
+void shm_ring_publish(shm_ring_t* ring, uint64_t pos) {
+    shm_ring_shared_t* shared = ring->shared;
+    atomic_store_explicit(&shared->slots[pos & ring->mask].seq, pos + 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&shared->consumer_waiting, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&shared->data_seq, 1, memory_order_release);
+        futex_wake(&shared->data_seq, 1);
+    }
+}
+
+/**
+ * @brief Restituisce la prossima richiesta pubblicata senza copiarla (solo backend).
+ * @return La richiesta, NULL se il ring è vuoto. Resta valida fino a shm_ring_release.
+ */
+emergency_request_t* shm_ring_peek(shm_ring_t* ring) {
+    uint64_t tail = atomic_load_explicit(&ring->shared->tail, memory_order_relaxed);
+    shm_ring_slot_t* slot = &ring->shared->slots[tail & ring->mask];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != tail + 1) return NULL;
+    return &slot->req;
+}
+
+/**
+ * @brief Restituisce ai produttori lo slot letto con shm_ring_peek (solo backend).
+ */
+void shm_ring_release(shm_ring_t* ring) {
+    shm_ring_shared_t* shared = ring->shared;
+    uint64_t tail = atomic_load_explicit(&shared->tail, memory_order_relaxed);
+    atomic_store_explicit(&shared->slots[tail & ring->mask].seq, tail + ring->capacity, memory_order_release);
+    atomic_store_explicit(&shared->tail, tail + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&shared->producers_waiting, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&shared->space_seq, 1, memory_order_release);
+        futex_wake(&shared->space_seq, INT_MAX);
+    }
+}
+
+/**
+ * @brief Attende che nel ring venga pubblicata almeno una richiesta (solo backend).
+ */
+void shm_ring_wait(shm_ring_t* ring) {
+    shm_ring_shared_t* shared = ring->shared;
+    uint32_t observed = atomic_load_explicit(&shared->data_seq, memory_order_acquire);
+    atomic_store_explicit(&shared->consumer_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!shm_ring_peek(ring))
+        futex_wait(&shared->data_seq, observed, NULL);
+    atomic_store_explicit(&shared->consumer_waiting, 0, memory_order_relaxed);
+}
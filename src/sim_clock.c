@@ -0,0 +1,398 @@
+#include "sim_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "logger.h"
+#include "macros.h"
+#include <threads.h>
+
+// Durata di un tick della ruota in millisecondi virtuali
+#define TICK_MS 10
+
+// Ruota gerarchica: WHEEL_LEVELS livelli da WHEEL_SLOTS slot ciascuno.
+// Il livello 0 copre 64 tick (640 ms), il livello 1 ~41 s, il 2 ~44 min, il 3 ~47 ore.
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+
+// Stati di un timer
+#define TIMER_IDLE 0
+#define TIMER_WHEEL 1
+#define TIMER_READY 2
+#define TIMER_RUNNING 3
+
+/**
+ * @brief Livello della ruota: liste di timer per slot e bitmap degli slot non vuoti.
+ */
+typedef struct {
+    sim_timer_t* slots[WHEEL_SLOTS];
+    unsigned long long occupied;    // Bit i a 1 se lo slot i contiene almeno un timer
+} wheel_level_t;
+
+// Ruota dei timer e tick corrente (primo tick non ancora elaborato)
+static wheel_level_t wheel[WHEEL_LEVELS];
+static long long current_tick = 0;
+static int wheel_count = 0;             // Timer presenti nella ruota
+
+// Coda FIFO dei timer scaduti in attesa di un worker
+static sim_timer_t* ready_head = NULL;
+static sim_timer_t* ready_tail = NULL;
+static int ready_count = 0;
+static int running_count = 0;           // Callback in esecuzione
+static int held_count = 0;              // Thread esterni che hanno bloccato l'avanzamento del tempo (sim_hold)
+
+// Parametri dell'orologio
+static double scale = 1.0;              // Fattore di accelerazione (0 = il più veloce possibile)
+static sim_time_t wall_start = 0;       // Istante reale di avvio (ms), origine del tempo virtuale
+static _Atomic sim_time_t virtual_now;  // Tempo virtuale corrente (usato in modalità "il più veloce possibile")
+
+// Sincronizzazione del motore
+static mtx_t sim_mutex;
+static cnd_t driver_cond;               // Risveglia il driver (nuovo timer o worker fermi)
+static cnd_t worker_cond;               // Risveglia i worker (nuovi timer pronti)
+static thrd_t driver_thread;
+
+/**
+ * @brief Restituisce l'istante reale corrente in millisecondi.
+ */
+static sim_time_t wall_ms() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (sim_time_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Restituisce l'istante corrente del tempo virtuale.
+ */
+sim_time_t sim_now() {
+    if (scale <= 0) return atomic_load(&virtual_now);
+    return wall_start + (sim_time_t)((wall_ms() - wall_start) * scale);
+}
+
+/**
+ * @brief Converte un istante virtuale nel tick della ruota che lo contiene.
+ */
+static long long time_to_tick(sim_time_t t) {
+    return (t - wall_start) / TICK_MS;
+}
+
+/**
+ * @brief Inserisce un timer nel livello/slot adatto alla sua scadenza (con mutex già acquisito).
+ */
+static void wheel_insert(sim_timer_t* t) {
+    long long expires = t->expires;
+    if (expires < current_tick) expires = current_tick; // Già scaduto: va elaborato subito
+    long long delta = expires - current_tick;
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1LL << (WHEEL_BITS * (level + 1)))) level++;
+    long long max_delta = 1LL << (WHEEL_BITS * WHEEL_LEVELS);
+    if (delta >= max_delta) expires = current_tick + max_delta - 1; // Oltre l'orizzonte: verrà ricollocato
+    int slot = (int)((expires >> (WHEEL_BITS * level)) & WHEEL_MASK);
+
+    t->level = level;
+    t->slot = slot;
+    t->prev = NULL;
+    t->next = wheel[level].slots[slot];
+    if (t->next) t->next->prev = t;
+    wheel[level].slots[slot] = t;
+    wheel[level].occupied |= 1ULL << slot;
+    t->state = TIMER_WHEEL;
+    wheel_count++;
+}
+
+/**
+ * @brief Stacca un timer dal suo slot della ruota (con mutex già acquisito).
+ */
+static void wheel_unlink(sim_timer_t* t) {
+    if (t->prev) t->prev->next = t->next;
+    else wheel[t->level].slots[t->slot] = t->next;
+    if (t->next) t->next->prev = t->prev;
+    if (!wheel[t->level].slots[t->slot]) wheel[t->level].occupied &= ~(1ULL << t->slot);
+    t->next = t->prev = NULL;
+    wheel_count--;
+}
+
+/**
+ * @brief Ricolloca tutti i timer di uno slot di un livello superiore (con mutex già acquisito).
+ * @return Indice dello slot ricollocato.
+ */
+static int wheel_cascade(int level, int slot) {
+    sim_timer_t* t = wheel[level].slots[slot];
+    wheel[level].slots[slot] = NULL;
+    wheel[level].occupied &= ~(1ULL << slot);
+    while (t) {
+        sim_timer_t* next = t->next;
+        wheel_count--;
+        wheel_insert(t);
+        t = next;
+    }
+    return slot;
+}
+
+/**
+ * @brief Elabora il tick corrente: ricolloca i livelli superiori e sposta i timer scaduti nella coda dei pronti.
+ */
+static void wheel_process_tick() {
+    int index = (int)(current_tick & WHEEL_MASK);
+    if (index == 0) {
+        // Inizio di un nuovo giro del livello 0: scende di un livello chi scade in questo giro
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            int slot = (int)((current_tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+            wheel_cascade(level, slot);
+            if (slot != 0) break;
+        }
+    }
+
+    sim_timer_t* t = wheel[0].slots[index];
+    wheel[0].slots[index] = NULL;
+    wheel[0].occupied &= ~(1ULL << index);
+    while (t) {
+        sim_timer_t* next = t->next;
+        wheel_count--;
+        // Accoda il timer tra i pronti
+        t->state = TIMER_READY;
+        t->next = NULL;
+        t->prev = ready_tail;
+        if (ready_tail) ready_tail->next = t;
+        else ready_head = t;
+        ready_tail = t;
+        ready_count++;
+        t = next;
+    }
+    current_tick++;
+}
+
+/**
+ * @brief Primo tick che può contenere lavoro: la prossima scadenza nel livello 0 oppure
+ * il prossimo inizio giro in cui un livello superiore ricolloca uno slot non vuoto.
+ * Usa le bitmap degli slot occupati, quindi non scorre i tick vuoti.
+ * @return Il tick, -1 se la ruota è vuota.
+ */
+static long long wheel_next_tick() {
+    if (wheel_count == 0) return -1;
+    long long best = -1;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        unsigned long long occupied = wheel[level].occupied;
+        if (!occupied) continue;
+        int shift = WHEEL_BITS * level;
+        // Primo giro del livello non ancora elaborato (per il livello 0 è il tick corrente)
+        long long first = (current_tick + (1LL << shift) - 1) >> shift;
+        int rot = (int)(first & WHEEL_MASK);
+        unsigned long long rotated = rot ? (occupied >> rot) | (occupied << (WHEEL_SLOTS - rot)) : occupied;
+        long long tick = (first + __builtin_ctzll(rotated)) << shift;
+        if (best < 0 || tick < best) best = tick;
+    }
+    return best;
+}
+
+/**
+ * @brief Porta la ruota fino al tick indicato (incluso), saltando i tick sicuramente vuoti.
+ */
+static void wheel_advance_to(long long target) {
+    while (current_tick <= target) {
+        long long next = wheel_next_tick();
+        if (next < 0 || next > target) {
+            current_tick = target + 1; // Nessun lavoro fino a target
+            return;
+        }
+        current_tick = next;
+        wheel_process_tick();
+    }
+}
+
+/**
+ * @brief Thread driver: fa avanzare la ruota secondo l'orologio virtuale e risveglia i worker.
+ *
+ * In tempo scalato segue l'orologio reale moltiplicato per la scala; nella modalità
+ * "il più veloce possibile" salta al prossimo tick con timer, ma solo quando nessuna
+ * callback è in coda o in esecuzione, così nessun timer viene programmato nel passato.
+ */
+static int sim_driver(void* arg) {
+    (void)arg;
+    mtx_lock(&sim_mutex);
+    while (1) {
+        if (scale > 0) {
+            wheel_advance_to(time_to_tick(sim_now()));
+            if (ready_count > 0) cnd_broadcast(&worker_cond);
+            long long next = wheel_next_tick();
+            if (next < 0) {
+                cnd_wait(&driver_cond, &sim_mutex);
+            } else {
+                // Dorme fino all'istante reale corrispondente al prossimo tick utile
+                sim_time_t due = wall_start + (sim_time_t)((next * TICK_MS) / scale);
+                struct timespec ts = { .tv_sec = due / 1000, .tv_nsec = (due % 1000) * 1000000 };
+                cnd_timedwait(&driver_cond, &sim_mutex, &ts);
+            }
+        } else {
+            long long next = wheel_next_tick();
+            if (ready_count > 0 || running_count > 0 || held_count > 0 || next < 0) {
+                cnd_wait(&driver_cond, &sim_mutex);
+                continue;
+            }
+            current_tick = next;
+            sim_time_t tick_time = wall_start + next * TICK_MS;
+            if (tick_time > atomic_load(&virtual_now)) atomic_store(&virtual_now, tick_time);
+            wheel_process_tick();
+            if (ready_count > 0) cnd_broadcast(&worker_cond);
+        }
+    }
+    mtx_unlock(&sim_mutex);
+    return 0;
+}
+
+/**
+ * @brief Thread worker: esegue le callback dei timer scaduti.
+ */
+static int sim_worker(void* arg) {
+    (void)arg;
+    mtx_lock(&sim_mutex);
+    while (1) {
+        while (!ready_head) {
+            cnd_wait(&worker_cond, &sim_mutex);
+        }
+        sim_timer_t* t = ready_head;
+        ready_head = t->next;
+        if (ready_head) ready_head->prev = NULL;
+        else ready_tail = NULL;
+        ready_count--;
+        t->next = t->prev = NULL;
+        t->state = TIMER_RUNNING;
+        running_count++;
+        mtx_unlock(&sim_mutex);
+
+        t->callback(t->arg); // La callback può riprogrammare il proprio timer
+
+        mtx_lock(&sim_mutex);
+        running_count--;
+        if (t->state == TIMER_RUNNING) t->state = TIMER_IDLE;
+        if (ready_count == 0 && running_count == 0 && held_count == 0) cnd_signal(&driver_cond);
+    }
+    mtx_unlock(&sim_mutex);
+    return 0;
+}
+
+/**
+ * @brief Blocca l'avanzamento del tempo virtuale (modalità "il più veloce possibile") finché non viene chiamata sim_release.
+ */
+void sim_hold() {
+    mtx_lock(&sim_mutex);
+    held_count++;
+    mtx_unlock(&sim_mutex);
+}
+
+/**
+ * @brief Rilascia il blocco impostato con sim_hold.
+ */
+void sim_release() {
+    mtx_lock(&sim_mutex);
+    held_count--;
+    if (ready_count == 0 && running_count == 0 && held_count == 0) cnd_signal(&driver_cond);
+    mtx_unlock(&sim_mutex);
+}
+
+/**
+ * @brief Avvia il motore ad eventi discreti: orologio virtuale, ruota dei timer e pool di worker.
+ * @param time_scale Fattore di accelerazione (1 = tempo reale, 0 = il più veloce possibile).
+ * @param workers Numero di thread worker.
+ */
+void sim_init(double time_scale, int workers) {
+    scale = time_scale > 0 ? time_scale : 0;
+    wall_start = wall_ms();
+    atomic_store(&virtual_now, wall_start); // Il tempo virtuale parte dall'istante reale di avvio
+    current_tick = 0;
+    mtx_init(&sim_mutex, mtx_plain);
+    cnd_init(&driver_cond);
+    cnd_init(&worker_cond);
+    if (workers < 1) workers = 1;
+
+    char log_msg[256];
+    if (scale > 0)
+        snprintf(log_msg, sizeof(log_msg), "Orologio virtuale avviato (scala %.0fx, %d worker)", scale, workers);
+    else
+        snprintf(log_msg, sizeof(log_msg), "Orologio virtuale avviato (il più veloce possibile, %d worker)", workers);
+    log_event("0500", "SIMULATION", log_msg);
+
+    for (int i = 0; i < workers; i++) {
+        thrd_t worker;
+        thrd_create(&worker, sim_worker, NULL);
+        thrd_detach(worker);
+    }
+    thrd_create(&driver_thread, sim_driver, NULL);
+}
+
+/**
+ * @brief Prepara un timer associandogli la callback da eseguire alla scadenza.
+ */
+void sim_timer_init(sim_timer_t* timer, void (*callback)(void* arg), void* arg) {
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->next = timer->prev = NULL;
+    timer->state = TIMER_IDLE;
+}
+
+/**
+ * @brief Stacca un timer dalla ruota o dalla coda dei pronti (con mutex già acquisito).
+ * @return 0 se il timer era programmato, -1 altrimenti.
+ */
+static int timer_detach(sim_timer_t* timer) {
+    if (timer->state == TIMER_WHEEL) {
+        wheel_unlink(timer);
+    } else if (timer->state == TIMER_READY) {
+        if (timer->prev) timer->prev->next = timer->next;
+        else ready_head = timer->next;
+        if (timer->next) timer->next->prev = timer->prev;
+        else ready_tail = timer->prev;
+        timer->next = timer->prev = NULL;
+        ready_count--;
+    } else {
+        return -1;
+    }
+    timer->state = TIMER_IDLE;
+    return 0;
+}
+
+/**
+ * @brief Programma un timer dopo un intervallo di tempo virtuale (riprogrammandolo se già attivo).
+ * @param timer Timer inizializzato con sim_timer_init.
+ * @param delay_ms Ritardo in millisecondi virtuali.
+ */
+void sim_schedule(sim_timer_t* timer, sim_time_t delay_ms) {
+    mtx_lock(&sim_mutex);
+    timer_detach(timer);
+    timer->expires = time_to_tick(sim_now() + delay_ms + TICK_MS - 1); // Arrotonda per eccesso: mai in anticipo
+    wheel_insert(timer);
+    cnd_signal(&driver_cond); // Il driver potrebbe dover anticipare il risveglio
+    mtx_unlock(&sim_mutex);
+}
+
+/**
+ * @brief Annulla un timer non ancora eseguito.
+ * @return 0 se il timer è stato annullato, -1 se non era programmato o è già in esecuzione.
+ */
+int sim_cancel(sim_timer_t* timer) {
+    mtx_lock(&sim_mutex);
+    int result = timer_detach(timer);
+    mtx_unlock(&sim_mutex);
+    return result;
+}
+
+/**
+ * @brief Annulla un timer non ancora eseguito e restituisce il tempo che mancava alla scadenza.
+ * @param timer Timer da annullare.
+ * @param remaining_ms Restituisce i millisecondi virtuali mancanti alla scadenza (0 se già scaduto).
+ * @return 0 se il timer è stato annullato, -1 se non era programmato o è già in esecuzione.
+ */
+int sim_cancel_remaining(sim_timer_t* timer, sim_time_t* remaining_ms) {
+    mtx_lock(&sim_mutex);
+    sim_time_t expires = wall_start + timer->expires * TICK_MS;
+    int result = timer_detach(timer);
+    mtx_unlock(&sim_mutex);
+    if (result == 0) {
+        sim_time_t left = expires - sim_now();
+        *remaining_ms = left > 0 ? left : 0;
+    }
+    return result;
+}
@@ -0,0 +1,231 @@
+#include "waitlist.h"
+#include "emergency_queue.h"
+#include "emergency_status.h"
+#include "rescuer_pool.h"
+#include "sim_clock.h"
+#include "logger.h"
+#include "macros.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <threads.h>
+
+/**
+ * @brief Emergenza parcheggiata in una lista d'attesa.
+ * Il nodo contiene il timer della scadenza, così l'emergenza resta compatta.
+ */
+typedef struct wait_node {
+    emergency_t* e;                 // Emergenza in attesa
+    int type_id;                    // Tipo di soccorritore atteso
+    int needed;                     // Numero di soccorritori del tipo richiesti
+    int has_deadline;               // 1 se il timer della scadenza è programmato
+    sim_timer_t deadline;           // Timer che scarta l'emergenza allo scadere del tempo massimo
+    struct wait_node* next;         // Nodo successivo nella lista (o nella free list)
+    struct wait_node* prev;         // Nodo precedente nella lista
+} wait_node_t;
+
+/**
+ * @brief Lista d'attesa di un tipo di soccorritore.
+ */
+typedef struct {
+    wait_node_t* head;              // Emergenza più urgente in attesa
+    wait_node_t* tail;              // Ultima emergenza in attesa
+    int capacity;                   // Numero totale di soccorritori del tipo
+    _Atomic int parked;             // Emergenze in attesa (letto senza lock da waitlist_notify)
+    mtx_t mutex;                    // Mutex della lista
+} waitlist_t;
+
+// Una lista per ogni tipo di soccorritore, indicizzata per ID del tipo
+static waitlist_t* lists = NULL;
+static int list_count = 0;
+
+// Nodi liberi, riciclati invece di liberarli (il timer resta inizializzato)
+static wait_node_t* free_nodes = NULL;
+static mtx_t nodes_mutex;
+
+/**
+ * @brief Inizializza una lista d'attesa (vuota) per ogni tipo di soccorritore.
+ * @param types Array dei tipi di soccorritore caricati da file.
+ * @param type_count Numero di tipi di soccorritore.
+ */
+void waitlist_init(rescuer_type_info_t* types, int type_count) {
+    mtx_init(&nodes_mutex, mtx_plain);
+    lists = calloc(type_count, sizeof(waitlist_t));
+    CHECK_MALLOC(lists, fail);
+    for (int i = 0; i < type_count; i++) {
+        lists[i].capacity = types[i].count; // types[i].rescuer_type.id == i
+        atomic_init(&lists[i].parked, 0);
+        mtx_init(&lists[i].mutex, mtx_plain);
+    }
+    list_count = type_count;
+    return;
+    fail:
+    list_count = 0;
+}
+
+/**
+ * @brief Stacca un nodo dalla sua lista (con mutex della lista già acquisito).
+ */
+static void list_unlink(waitlist_t* wl, wait_node_t* node) {
+    if (node->prev) node->prev->next = node->next;
+    else wl->head = node->next;
+    if (node->next) node->next->prev = node->prev;
+    else wl->tail = node->prev;
+    node->next = node->prev = NULL;
+    atomic_fetch_sub(&wl->parked, 1);
+}
+
+/**
+ * @brief Restituisce un nodo alla free list.
+ */
+static void node_put(wait_node_t* node) {
+    mtx_lock(&nodes_mutex);
+    node->next = free_nodes;
+    free_nodes = node;
+    mtx_unlock(&nodes_mutex);
+}
+
+/**
+ * @brief Callback del timer di scadenza: l'emergenza non può più essere gestita in tempo.
+ * Il nodo è ancora in lista: chi risveglia le emergenze salta quelle il cui timer è già partito.
+ */
+static void deadline_expired(void* arg) {
+    wait_node_t* node = arg;
+    waitlist_t* wl = &lists[node->type_id];
+    mtx_lock(&wl->mutex);
+    list_unlink(wl, node);
+    mtx_unlock(&wl->mutex);
+
+    emergency_t* e = node->e;
+    printf("❌ [WAITLIST] Emergenza scartata: %s (%d,%d), tempo massimo superato in attesa\n",
+           e->type->emergency_desc, e->x, e->y);
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Emergenza scartata: %s (%d,%d), tempo massimo superato in attesa di soccorritori (priorità %d)",
+           e->type->emergency_desc, e->x, e->y, e->priority);
+    char id [5];
+    snprintf(id, sizeof(id), "1%03d", e->id);
+    log_emergency_event(e->id, id, "WAITLIST", log_msg);
+    update_emergency_status(e, TIMEOUT); // Aggiorna lo stato dell'emergenza
+    node_put(node);
+}
+
+/**
+ * @brief Parcheggia un'emergenza in attesa dei soccorritori di un tipo.
+ * @param e Emergenza (in stato WAITING, fuori dalla coda).
+ * @param req Richiesta dell'emergenza rimasta senza soccorritori liberi.
+ * @param max_time Tempo massimo di gestione in secondi (-1 se senza limite).
+ * @param min_time Secondi che serviranno comunque una volta liberi i soccorritori (viaggio e intervento residuo).
+ * @return 0 se l'emergenza è stata parcheggiata, -1 se non può attendere.
+ */
+int waitlist_park(emergency_t* e, const rescuer_request_t* req, int max_time, int min_time) {
+    if (req->type_id < 0 || req->type_id >= list_count) return -1;
+    waitlist_t* wl = &lists[req->type_id];
+    if (req->required_count > wl->capacity) return -1; // Non basterebbero neanche tutti i soccorritori del tipo
+
+    sim_time_t now = sim_now();
+    if (!e->waiting_since) e->waiting_since = now;
+
+    // Tempo ancora disponibile per attendere: il resto serve per arrivare e completare l'intervento
+    sim_time_t remaining = -1;
+    if (max_time > 0) {
+        remaining = (sim_time_t)(max_time - min_time) * 1000 - (now - e->waiting_since);
+        if (remaining <= 0) return -1;
+    }
+
+    mtx_lock(&nodes_mutex);
+    wait_node_t* node = free_nodes;
+    if (node) free_nodes = node->next;
+    mtx_unlock(&nodes_mutex);
+    if (!node) {
+        node = malloc(sizeof(wait_node_t));
+        CHECK_MALLOC(node, fail);
+        sim_timer_init(&node->deadline, deadline_expired, node);
+    }
+    node->e = e;
+    node->type_id = req->type_id;
+    node->needed = req->required_count;
+    node->has_deadline = remaining > 0;
+
+    // Dopo l'inserimento l'emergenza può essere risvegliata e gestita da altri thread: i dati per il log si leggono prima
+    int em_id = e->id;
+    const char* desc = e->type->emergency_desc;
+
+    mtx_lock(&wl->mutex);
+    // Inserisce dopo le emergenze con priorità maggiore o uguale (a parità resta l'ordine di arrivo)
+    wait_node_t* after = wl->tail;
+    while (after && after->e->priority < e->priority) after = after->prev;
+    node->prev = after;
+    node->next = after ? after->next : wl->head;
+    if (node->next) node->next->prev = node;
+    else wl->tail = node;
+    if (after) after->next = node;
+    else wl->head = node;
+    atomic_fetch_add(&wl->parked, 1);
+    int parked = atomic_load(&wl->parked);
+    if (node->has_deadline) sim_schedule(&node->deadline, remaining);
+    mtx_unlock(&wl->mutex);
+
+    printf("⏳ [WAITLIST] Emergenza %s (id: %02d) in attesa di %d soccorritori del tipo %s\n",
+           desc, em_id, req->required_count, req->type->rescuer_type_name);
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Emergenza in attesa di %d soccorritori del tipo %s (emergenze in attesa: %d)",
+           req->required_count, req->type->rescuer_type_name, parked);
+    char id [5];
+    snprintf(id, sizeof(id), "0%03d", em_id);
+    log_emergency_event(em_id, id, "WAITLIST", log_msg);
+
+    // Un soccorritore può essere tornato libero mentre l'emergenza veniva parcheggiata
+    atomic_thread_fence(memory_order_seq_cst);
+    waitlist_notify(req->type_id, rescuer_pool_idle_count(req->type_id));
+    return 0;
+    fail:
+    return -1;
+}
+
+/**
+ * @brief Segnala che un soccorritore del tipo indicato è tornato libero.
+ * @param type_id ID del tipo di soccorritore.
+ * @param idle_count Numero di soccorritori liberi del tipo.
+ */
+void waitlist_notify(int type_id, int idle_count) {
+    if (type_id < 0 || type_id >= list_count) return;
+    waitlist_t* wl = &lists[type_id];
+    // Accoppiato alla barriera di waitlist_park: o qui si vede l'emergenza parcheggiata,
+    // o waitlist_park vede il soccorritore appena liberato
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&wl->parked, memory_order_relaxed) == 0) return;
+
+    wait_node_t* woken = NULL;
+    wait_node_t** woken_tail = &woken;
+    mtx_lock(&wl->mutex);
+    wait_node_t* node = wl->head;
+    // Risveglia in ordine: un'emergenza meno urgente non supera quella in testa che non può ancora partire
+    while (node && node->needed <= idle_count) {
+        wait_node_t* next = node->next;
+        // Se il timer della scadenza è già partito l'emergenza appartiene alla sua callback
+        if (!node->has_deadline || sim_cancel(&node->deadline) == 0) {
+            list_unlink(wl, node);
+            idle_count -= node->needed;
+            *woken_tail = node; // Mantiene l'ordine della lista
+            woken_tail = &node->next;
+        }
+        node = next;
+    }
+    mtx_unlock(&wl->mutex);
+
+    // Rimette le emergenze risvegliate nella coda dello scheduler
+    while (woken) {
+        wait_node_t* next = woken->next;
+        emergency_t* e = woken->e;
+        node_put(woken);
+        if (emergency_queue_requeue(e) != 0) {
+            char log_msg[256];
+            snprintf(log_msg, sizeof(log_msg), "Memoria insufficiente: impossibile riaccodare l'emergenza %s in attesa", e->type->emergency_desc);
+            char id [5];
+            snprintf(id, sizeof(id), "1%03d", e->id);
+            log_emergency_event(e->id, id, "WAITLIST", log_msg);
+            update_emergency_status(e, TIMEOUT); // Aggiorna lo stato dell'emergenza
+        }
+        woken = next;
+    }
+}